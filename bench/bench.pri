@@ -0,0 +1,14 @@
+# common settings of the benchmarks. Each one builds the app sources it needs (see its SOURCES).
+# Not part of make check (no testcase) and always optimized.
+QT += core testlib
+QT -= gui
+
+CONFIG += c++11
+CONFIG += warn_on
+CONFIG += console release
+CONFIG -= app_bundle debug
+
+TEMPLATE = app
+
+INCLUDEPATH += $$PWD/.. $$PWD $$PWD/../tests
+HEADERS += $$PWD/frames.h $$PWD/mapbook.h
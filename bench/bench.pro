@@ -0,0 +1,9 @@
+# benchmarks. qmake bench/bench.pro && make, then run e.g. bench_books/bench_books
+# (QtTest options like -iterations 10 or -tickcounter apply)
+TEMPLATE = subdirs
+
+SUBDIRS += bench_books \
+    bench_snapshots \
+    bench_trades \
+    bench_parsers \
+    bench_routing
@@ -0,0 +1,213 @@
+#include <vector>
+#include <QtTest>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include "channel.h"
+#include "testexchange.h"
+#include "frames.h"
+#include "mapbook.h"
+
+/* replays the book updates of bitfinex, binance and hitbtc (see frames.h) into
+ * the flat ChannelBooks sides (BookSide) and into the former std::map book
+ * (MapBook, the code before the change).
+ * The frames are decoded beforehand into the handleSingleEntry arguments, so only
+ * the book updates (and the getPrices queries) are measured.
+ */
+class bench_Books : public QObject
+{
+    Q_OBJECT
+private slots:
+    void replay_data();
+    void replay();
+    void replayWithQueries_data();
+    void replayWithQueries();
+};
+
+namespace {
+
+class Entry
+{
+public:
+    double _price;
+    qint64 _ticks;
+    int _count; // -1 -> absolute amount
+    double _amount;
+};
+
+class Replay
+{
+public:
+    std::vector<Entry> _entries;
+    std::vector<std::size_t> _frameEnds; // end of the entries of each frame
+    double _tickSize;
+    double _queryAmount; // for getPrices. About the amount of the best 4-5 levels
+    void add(double price, int count, double amount)
+    {
+        _entries.push_back(Entry{price, std::llround(price * (1.0 / _tickSize)), count, amount});
+    }
+};
+
+// same semantics as the channels: bitfinex [PRICE,COUNT,AMOUNT] as is, the absolute
+// binance/hitbtc sizes with count -1 (size 0 -> count 0)
+static void addAbsolute(Replay &r, double price, double size, bool bid)
+{
+    if (bid)
+        r.add(price, size == 0.0 ? 0 : -1, size == 0.0 ? 1.0 : size);
+    else
+        r.add(price, size == 0.0 ? 0 : -1, -size);
+}
+
+static Replay decode(const QString &exchange, int nrFrames)
+{
+    Replay r;
+    if (exchange == "bitfinex") {
+        r._tickSize = BitfinexFrames::tickSize();
+        r._queryAmount = 40.0;
+        for (const QString &frame : BitfinexFrames::updates(nrFrames)) {
+            const QJsonArray data = QJsonDocument::fromJson(frame.toUtf8()).array();
+            const QJsonArray levels = data.at(1).toArray();
+            if (levels.isEmpty()) continue; // hb, ...
+            if (levels.at(0).isArray()) { // snapshot
+                for (const auto &l : levels) {
+                    const QJsonArray a = l.toArray();
+                    r.add(a[0].toDouble(), a[1].toInt(), a[2].toDouble());
+                }
+            } else
+                r.add(levels[0].toDouble(), levels[1].toInt(), levels[2].toDouble());
+            r._frameEnds.push_back(r._entries.size());
+        }
+    } else if (exchange == "binance") {
+        r._tickSize = BinanceFrames::tickSize();
+        r._queryAmount = 400.0;
+        for (const QString &frame : BinanceFrames::updates(nrFrames, 1000)) {
+            QJsonObject data = QJsonDocument::fromJson(frame.toUtf8()).object();
+            if (data.contains("data")) data = data["data"].toObject();
+            for (const auto &b : data["b"].toArray())
+                addAbsolute(r, b.toArray()[0].toString().toDouble(), b.toArray()[1].toString().toDouble(), true);
+            for (const auto &a : data["a"].toArray())
+                addAbsolute(r, a.toArray()[0].toString().toDouble(), a.toArray()[1].toString().toDouble(), false);
+            r._frameEnds.push_back(r._entries.size());
+        }
+    } else {
+        r._tickSize = HitbtcFrames::tickSize();
+        r._queryAmount = 40.0;
+        for (const QString &frame : HitbtcFrames::updates(nrFrames)) {
+            const QJsonObject params = QJsonDocument::fromJson(frame.toUtf8()).object()["params"].toObject();
+            for (const auto &b : params["bid"].toArray())
+                addAbsolute(r, b.toObject()["price"].toString().toDouble(), b.toObject()["size"].toString().toDouble(), true);
+            for (const auto &a : params["ask"].toArray())
+                addAbsolute(r, a.toObject()["price"].toString().toDouble(), a.toObject()["size"].toString().toDouble(), false);
+            r._frameEnds.push_back(r._entries.size());
+        }
+    }
+    return r;
+}
+
+class FlatBook : public ChannelBooks
+{
+public:
+    FlatBook(Exchange *exchange, const double &tickSize) : ChannelBooks(exchange, 1, "tBTCUSD") { setTickSize(tickSize); }
+    void handleSingleEntry(const Entry &e) { ChannelBooks::handleSingleEntry(e._ticks, e._count, e._amount); }
+    std::size_t nrBids() const { return _bids.size(); }
+    std::size_t nrAsks() const { return _asks.size(); }
+    double bestBid() const { return _bids.empty() ? 0.0 : toPrice(_bids.best()._price); }
+    double bestAsk() const { return _asks.empty() ? 0.0 : toPrice(_asks.best()._price); }
+};
+
+} // namespace
+
+static const int NrFrames = 20000;
+
+void bench_Books::replay_data()
+{
+    QTest::addColumn<QString>("exchange");
+    QTest::addColumn<bool>("useMap");
+    for (const char *exchange : { "bitfinex", "binance", "hitbtc" }) {
+        QTest::newRow(qPrintable(QString("%1 map").arg(exchange))) << QString(exchange) << true;
+        QTest::newRow(qPrintable(QString("%1 flat").arg(exchange))) << QString(exchange) << false;
+    }
+}
+
+void bench_Books::replay()
+{
+    QFETCH(QString, exchange);
+    QFETCH(bool, useMap);
+    const Replay r = decode(exchange, NrFrames);
+    QVERIFY(r._entries.size() >= (std::size_t)NrFrames);
+    TestExchange testExchange;
+
+    // both have to end up with the same book:
+    {
+        MapBook map;
+        FlatBook flat(&testExchange, r._tickSize);
+        for (const auto &e : r._entries) {
+            map.handleSingleEntry(e._price, e._count, e._amount);
+            flat.handleSingleEntry(e);
+        }
+        QCOMPARE(flat.nrBids(), map._bids.size());
+        QCOMPARE(flat.nrAsks(), map._asks.size());
+        QVERIFY(!map._bids.empty() && !map._asks.empty());
+        QVERIFY(std::fabs(flat.bestBid() - map._bids.begin()->first) < r._tickSize / 2);
+        QVERIFY(std::fabs(flat.bestAsk() - map._asks.begin()->first) < r._tickSize / 2);
+    }
+
+    if (useMap) {
+        QBENCHMARK {
+            MapBook book;
+            for (const auto &e : r._entries)
+                book.handleSingleEntry(e._price, e._count, e._amount);
+        }
+    } else {
+        QBENCHMARK {
+            FlatBook book(&testExchange, r._tickSize);
+            for (const auto &e : r._entries)
+                book.handleSingleEntry(e);
+        }
+    }
+}
+
+void bench_Books::replayWithQueries_data()
+{
+    replay_data();
+}
+
+// as the strategies do: after each frame where could we buy and sell the query amount
+void bench_Books::replayWithQueries()
+{
+    QFETCH(QString, exchange);
+    QFETCH(bool, useMap);
+    const Replay r = decode(exchange, NrFrames);
+    TestExchange testExchange;
+    double sum = 0.0;
+    double avg, limit;
+
+    if (useMap) {
+        QBENCHMARK {
+            MapBook book;
+            std::size_t i = 0;
+            for (const std::size_t end : r._frameEnds) {
+                for (; i < end; ++i)
+                    book.handleSingleEntry(r._entries[i]._price, r._entries[i]._count, r._entries[i]._amount);
+                if (book.getPrices(true, r._queryAmount, avg, limit)) sum += avg;
+                if (book.getPrices(false, r._queryAmount, avg, limit)) sum += avg;
+            }
+        }
+    } else {
+        QBENCHMARK {
+            FlatBook book(&testExchange, r._tickSize);
+            std::size_t i = 0;
+            for (const std::size_t end : r._frameEnds) {
+                for (; i < end; ++i)
+                    book.handleSingleEntry(r._entries[i]);
+                if (book.getPrices(true, r._queryAmount, avg, limit)) sum += avg;
+                if (book.getPrices(false, r._queryAmount, avg, limit)) sum += avg;
+            }
+        }
+    }
+    QVERIFY(sum > 0.0);
+}
+
+QTEST_GUILESS_MAIN(bench_Books)
+
+#include "bench_books.moc"
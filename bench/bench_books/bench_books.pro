@@ -0,0 +1,12 @@
+include(../bench.pri)
+
+TARGET = bench_books
+
+HEADERS += $$PWD/../../tests/testexchange.h \
+    $$PWD/../../channel.h \
+    $$PWD/../../exchange.h \
+    $$PWD/../../bookside.h
+SOURCES += bench_books.cpp \
+    $$PWD/../../channel.cpp \
+    $$PWD/../../exchange.cpp \
+    $$PWD/../../roundingdouble.cpp
@@ -0,0 +1,316 @@
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+#include <QtTest>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include "channel.h"
+#include "exchangebinance.h"
+#include "exchangebitfinex.h"
+#include "exchangebitflyer.h"
+#include "exchangehitbtc.h"
+#include "testexchange.h"
+#include "frames.h"
+
+/* the market data frames of bitfinex (book updates), binance (@depth diffs), hitbtc
+ * (updateOrderbook) and bitFlyer (executions) fed into their channels
+ * - dom: QJsonDocument::fromJson(msg.toUtf8()) and the channel handlers taking the json
+ *   objects, as the exchanges do for all messages the scanner doesn't handle
+ * - scanner: the JsonScanner decoders of the exchanges into the compact update structs
+ *   (with the dom as fallback, e.g. for the hitbtc snapshot):
+ *   ExchangeBitfinex::decodeChannelUpdate -> ChannelBooks::handleBitfinexUpdate,
+ *   ExchangeBinance::handleStreamDataFast -> ChannelBooks::handleBinanceUpdate,
+ *   ExchangeHitbtc::decodeOrderbookUpdate -> ChannelBooks::handleHitbtcUpdate,
+ *   ExchangeBitFlyer::handleChannelMessageFast -> ChannelTrades::handleTrade.
+ *   The binance @trade stream (handleStreamDataFast -> ChannelTrades::handleTrade) isn't
+ *   part of the frames.
+ * Set CRYPTOTRADER_BENCH_BITFINEX/_BINANCE/_HITBTC/_BITFLYER to use captured frames (see frames.h).
+ * allocations reports the heap allocations per frame (operator new below) of both paths.
+ */
+class bench_Parsers : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void parse_data();
+    void parse();
+    void allocations_data();
+    void allocations();
+};
+
+// counts all heap allocations of the process (single threaded here)
+static quint64 nrAllocs = 0;
+
+void *operator new(std::size_t size)
+{
+    ++nrAllocs;
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+class Book : public ChannelBooks
+{
+public:
+    Book(Exchange *exchange, int id, const QString &symbol, const double &tickSize) :
+        ChannelBooks(exchange, id, symbol) { setTickSize(tickSize); }
+    void gotSnapshot() { _bitFlyerGotSnapshot = true; } // bitfinex: only updates in the frames
+    QString state() const
+    {
+        return QString("bids %1 asks %2 best %3 %4").arg((int)_bids.size()).arg((int)_asks.size())
+                .arg(_bids.empty() ? 0.0 : toPrice(_bids.best()._price), 0, 'g', 12)
+                .arg(_asks.empty() ? 0.0 : toPrice(_asks.best()._price), 0, 'g', 12);
+    }
+};
+
+// one channel of an exchange getting the frames
+class Feed
+{
+public:
+    Feed() : _nrFallbacks(0) {}
+    virtual ~Feed() {}
+    virtual void dom(const QString &msg) = 0;
+    virtual bool scanner(const QString &msg) = 0; // false -> not handled
+    virtual QString state() const = 0;
+    void handle(const QString &msg, bool useScanner)
+    {
+        if (useScanner && scanner(msg)) return;
+        if (useScanner) ++_nrFallbacks;
+        dom(msg);
+    }
+    int _nrFallbacks;
+};
+
+class BitfinexFeed : public Feed
+{
+public:
+    explicit BitfinexFeed(Exchange *exchange) :
+        _book(exchange, BitfinexFrames::ChanId, "tBTCUSD", BitfinexFrames::tickSize()) { _book.gotSnapshot(); }
+    void dom(const QString &msg) override
+    {
+        const QJsonArray data = QJsonDocument::fromJson(msg.toUtf8()).array();
+        if (data.at(0).toInt() == _book.id())
+            _book.handleChannelData(data);
+    }
+    bool scanner(const QString &msg) override
+    {
+        int channelId;
+        int sequence;
+        if (ExchangeBitfinex::decodeChannelUpdate(msg, 0, channelId, _update, sequence) < 0) return false;
+        if (channelId != _book.id()) return false;
+        _book.handleBitfinexUpdate(_update);
+        return true;
+    }
+    QString state() const override { return _book.state(); }
+private:
+    Book _book;
+    BitfinexUpdate _update;
+};
+
+class BinanceFeed : public Feed
+{
+public:
+    BinanceFeed(Exchange *exchange, const QJsonObject &restSnapshot) :
+        _book(exchange, 1, "BNBBTC", BinanceFrames::tickSize())
+    {
+        ExchangeBinance::StreamRoute route;
+        route._kind = ExchangeBinance::StreamRoute::Depth;
+        route._books = &_book;
+        route._trades = 0;
+        _routes.insert("bnbbtc@depth", route);
+        _book.handleDataFromBinance(restSnapshot, true);
+    }
+    void dom(const QString &msg) override
+    { // as ExchangeBinance::onWsTextMessageReceived
+        const QJsonObject obj = QJsonDocument::fromJson(msg.toUtf8()).object();
+        const ExchangeBinance::StreamRoute *route = _routes.find(obj["stream"].toString());
+        if (route && route->_books)
+            route->_books->handleDataFromBinance(obj["data"].toObject(), false);
+    }
+    bool scanner(const QString &msg) override
+    {
+        return ExchangeBinance::handleStreamDataFast(msg, _routes, _diff);
+    }
+    QString state() const override { return _book.state(); }
+private:
+    Book _book;
+    StreamRoutes<ExchangeBinance::StreamRoute> _routes;
+    BinanceDiff _diff;
+};
+
+class HitbtcFeed : public Feed
+{
+public:
+    explicit HitbtcFeed(Exchange *exchange) :
+        _book(exchange, 1, "ETHBTC", HitbtcFrames::tickSize())
+    {
+        _routes.insert("ETHBTC", &_book);
+    }
+    void dom(const QString &msg) override
+    {
+        const QJsonObject obj = QJsonDocument::fromJson(msg.toUtf8()).object();
+        const QString method = obj["method"].toString();
+        const QJsonObject params = obj["params"].toObject();
+        ChannelBooks * const *book = _routes.find(params["symbol"].toString());
+        if (!book) return;
+        if (method == "snapshotOrderbook")
+            (*book)->handleDataFromHitbtc(params, true);
+        else if (method == "updateOrderbook")
+            (*book)->handleDataFromHitbtc(params, false);
+    }
+    bool scanner(const QString &msg) override
+    {
+        int symbolBegin;
+        int symbolLen;
+        if (!ExchangeHitbtc::decodeOrderbookUpdate(msg, _update, symbolBegin, symbolLen)) return false;
+        ChannelBooks * const *book = _routes.find(msg.utf16() + symbolBegin, symbolLen);
+        if (!book) return false;
+        (*book)->handleHitbtcUpdate(_update);
+        return true;
+    }
+    QString state() const override { return _book.state(); }
+private:
+    Book _book;
+    StreamRoutes<ChannelBooks *> _routes;
+    HitbtcUpdate _update;
+};
+
+class BitFlyerFeed : public Feed
+{
+public:
+    explicit BitFlyerFeed(Exchange *exchange) :
+        _trades(exchange, 1, "FX_BTC_JPY", "FX_BTC_JPY")
+    {
+        _trades.setTickSize(1.0);
+        ExchangeBitFlyer::ChannelRoute route;
+        route._kind = ExchangeBitFlyer::ChannelRoute::Executions;
+        route._books = 0;
+        route._trades = &_trades;
+        _routes.insert("lightning_executions_FX_BTC_JPY", route);
+    }
+    void dom(const QString &msg) override
+    { // as ExchangeBitFlyer::processMsg for the executions
+        const QJsonObject params = QJsonDocument::fromJson(msg.toUtf8()).object()["params"].toObject();
+        const ExchangeBitFlyer::ChannelRoute *route = _routes.find(params["channel"].toString());
+        if (!route || route->_kind != ExchangeBitFlyer::ChannelRoute::Executions) return;
+        for (const auto &e : params["message"].toArray())
+            route->_trades->handleDataFromBitFlyer(e.toObject());
+    }
+    bool scanner(const QString &msg) override
+    {
+        return ExchangeBitFlyer::handleChannelMessageFast(msg, _routes, _executions);
+    }
+    QString state() const override
+    {
+        const ChannelTrades::Trades &trades = _trades.trades();
+        if (trades.empty()) return QString("no trades");
+        const ChannelTrades::TradesItem &t = trades.back();
+        return QString("trades %1 last %2 %3 %4 %5").arg((qulonglong)trades.seq()).arg(t._id).arg(t._mts)
+                .arg(t._amount, 0, 'g', 12).arg(_trades.toPrice(t._price), 0, 'g', 12);
+    }
+private:
+    ChannelTrades _trades;
+    StreamRoutes<ExchangeBitFlyer::ChannelRoute> _routes;
+    std::vector<ExchangeBitFlyer::Execution> _executions;
+};
+
+} // namespace
+
+static const int NrFrames = 20000;
+static const qint64 LastUpdateId = 1000; // of the binance REST snapshot
+
+static QStringList framesOf(const QString &exchange)
+{
+    if (exchange == "bitfinex") return BitfinexFrames::updates(NrFrames);
+    if (exchange == "binance") return BinanceFrames::updates(NrFrames, LastUpdateId);
+    if (exchange == "hitbtc") return HitbtcFrames::updates(NrFrames);
+    return BitFlyerFrames::executions(NrFrames);
+}
+
+static std::unique_ptr<Feed> newFeed(const QString &exchange, Exchange *testExchange, const QJsonObject &restSnapshot)
+{
+    if (exchange == "bitfinex") return std::unique_ptr<Feed>(new BitfinexFeed(testExchange));
+    if (exchange == "binance") return std::unique_ptr<Feed>(new BinanceFeed(testExchange, restSnapshot));
+    if (exchange == "hitbtc") return std::unique_ptr<Feed>(new HitbtcFeed(testExchange));
+    return std::unique_ptr<Feed>(new BitFlyerFeed(testExchange));
+}
+
+void bench_Parsers::initTestCase()
+{
+    QLoggingCategory::setFilterRules("channel.debug=false");
+}
+
+void bench_Parsers::parse_data()
+{
+    QTest::addColumn<QString>("exchange");
+    QTest::addColumn<bool>("useScanner");
+    for (const char *exchange : { "bitfinex", "binance", "hitbtc", "bitflyer" }) {
+        QTest::newRow(qPrintable(QString("%1 dom").arg(exchange))) << QString(exchange) << false;
+        QTest::newRow(qPrintable(QString("%1 scanner").arg(exchange))) << QString(exchange) << true;
+    }
+}
+
+void bench_Parsers::parse()
+{
+    QFETCH(QString, exchange);
+    QFETCH(bool, useScanner);
+    const QJsonObject restSnapshot = QJsonDocument::fromJson(BinanceFrames::restSnapshot(LastUpdateId).toUtf8()).object();
+    const QStringList frames = framesOf(exchange);
+    QVERIFY(frames.size() > 0);
+    TestExchange testExchange;
+
+    // both have to end up with the same channel data and the scanner has to handle most frames:
+    {
+        std::unique_ptr<Feed> dom = newFeed(exchange, &testExchange, restSnapshot);
+        std::unique_ptr<Feed> scanner = newFeed(exchange, &testExchange, restSnapshot);
+        for (const QString &frame : frames) {
+            dom->handle(frame, false);
+            scanner->handle(frame, true);
+        }
+        QCOMPARE(scanner->state(), dom->state());
+        QVERIFY(scanner->_nrFallbacks < frames.size() / 100 + 1);
+        if (exchange == "bitflyer" && qgetenv("CRYPTOTRADER_BENCH_BITFLYER").isEmpty())
+            QCOMPARE(scanner->_nrFallbacks, 0); // all generated exec_date have to be parsed
+    }
+
+    QBENCHMARK {
+        std::unique_ptr<Feed> feed = newFeed(exchange, &testExchange, restSnapshot);
+        for (const QString &frame : frames)
+            feed->handle(frame, useScanner);
+    }
+}
+
+void bench_Parsers::allocations_data()
+{
+    parse_data();
+}
+
+// heap allocations per frame once the channel is set up. Reported as "events" per frame
+void bench_Parsers::allocations()
+{
+    QFETCH(QString, exchange);
+    QFETCH(bool, useScanner);
+    const QJsonObject restSnapshot = QJsonDocument::fromJson(BinanceFrames::restSnapshot(LastUpdateId).toUtf8()).object();
+    const QStringList frames = framesOf(exchange);
+    QVERIFY(frames.size() > 0);
+    TestExchange testExchange;
+    std::unique_ptr<Feed> feed = newFeed(exchange, &testExchange, restSnapshot);
+    const quint64 before = nrAllocs;
+    for (const QString &frame : frames)
+        feed->handle(frame, useScanner);
+    const quint64 allocs = nrAllocs - before;
+    QTest::setBenchmarkResult((qreal)allocs / frames.size(), QTest::Events);
+}
+
+QTEST_GUILESS_MAIN(bench_Parsers)
+
+#include "bench_parsers.moc"
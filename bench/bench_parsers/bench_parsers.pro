@@ -0,0 +1,27 @@
+include(../bench.pri)
+
+QT += network websockets
+
+TARGET = bench_parsers
+
+HEADERS += $$PWD/../../tests/testexchange.h \
+    $$PWD/../../exchangebinance.h \
+    $$PWD/../../exchangebitfinex.h \
+    $$PWD/../../exchangebitflyer.h \
+    $$PWD/../../exchangehitbtc.h \
+    $$PWD/../../exchangenam.h \
+    $$PWD/../../exchange.h \
+    $$PWD/../../channel.h \
+    $$PWD/../../channelaccountinfo.h \
+    $$PWD/../../jsonscanner.h \
+    $$PWD/../../streamroutes.h
+SOURCES += bench_parsers.cpp \
+    $$PWD/../../exchangebinance.cpp \
+    $$PWD/../../exchangebitfinex.cpp \
+    $$PWD/../../exchangebitflyer.cpp \
+    $$PWD/../../exchangehitbtc.cpp \
+    $$PWD/../../exchangenam.cpp \
+    $$PWD/../../exchange.cpp \
+    $$PWD/../../channel.cpp \
+    $$PWD/../../channelaccountinfo.cpp \
+    $$PWD/../../roundingdouble.cpp
@@ -0,0 +1,136 @@
+#include <map>
+#include <memory>
+#include <QtTest>
+#include <QStringList>
+#include "channel.h"
+#include "exchangebinance.h"
+#include "testexchange.h"
+
+/* dispatch of binance combined stream messages by their stream name ("bnbbtc@depth",
+ * "bnbbtc@trade") to the target channel:
+ * - map: contains("@depth"), split('@')[0], toUpper() and the std::map<QString,..> find
+ *   as ExchangeBinance::onWsTextMessageReceived did before the routes
+ * - routes: the StreamRoutes lookup on the raw characters (ExchangeBinance::_streamRoutes)
+ * Only the dispatch is measured. The stream names are taken from the messages beforehand.
+ */
+class bench_Routing : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void dispatch_data();
+    void dispatch();
+};
+
+namespace {
+
+typedef std::map<QString, std::pair<std::shared_ptr<ChannelBooks>, std::shared_ptr<ChannelTrades>>> SubscribedChannels;
+typedef StreamRoutes<ExchangeBinance::StreamRoute> Routes;
+
+// the target channel (and complete flag for books) as a number to compare and sum up
+static quintptr dispatchMap(const SubscribedChannels &channels, const QString &stream)
+{
+    if (stream.contains("@depth")) {
+        bool complete = !stream.endsWith("@depth");
+        QString symbol = stream.split('@')[0];
+        auto it = channels.find(symbol.toUpper());
+        if (it != channels.end()) {
+            auto &ch = (*it).second.first; // first = channelBooks
+            if (ch)
+                return (quintptr)ch.get() + complete;
+        }
+    } else
+        if (stream.contains("@trade")) {
+            QString symbol = stream.split('@')[0];
+            auto it = channels.find(symbol.toUpper());
+            if (it != channels.end()) {
+                auto &ch = (*it).second.second; // second = channel trade
+                if (ch)
+                    return (quintptr)ch.get();
+            }
+        }
+    return 0;
+}
+
+static quintptr dispatchRoutes(const Routes &routes, const QString &stream)
+{
+    const ExchangeBinance::StreamRoute *route = routes.find(stream.utf16(), stream.length());
+    if (!route) return 0;
+    if (route->_kind == ExchangeBinance::StreamRoute::Depth)
+        return (quintptr)route->_books; // only diffs (complete=false) are routed
+    return (quintptr)route->_trades;
+}
+
+} // namespace
+
+static const int NrMessages = 200000;
+
+void bench_Routing::initTestCase()
+{
+    QLoggingCategory::setFilterRules("channel.debug=false");
+}
+
+void bench_Routing::dispatch_data()
+{
+    QTest::addColumn<int>("nrSymbols");
+    QTest::addColumn<bool>("useMap");
+    for (int nrSymbols : { 2, 20 }) {
+        QTest::newRow(qPrintable(QString("%1 symbols map").arg(nrSymbols))) << nrSymbols << true;
+        QTest::newRow(qPrintable(QString("%1 symbols routes").arg(nrSymbols))) << nrSymbols << false;
+    }
+}
+
+void bench_Routing::dispatch()
+{
+    QFETCH(int, nrSymbols);
+    QFETCH(bool, useMap);
+    static const char *symbols[] = {
+        "BNBBTC", "ETHBTC", "LTCBTC", "NEOBTC", "XRPBTC", "EOSBTC", "TRXBTC", "ADABTC", "XLMBTC", "IOTABTC",
+        "XMRBTC", "DASHBTC", "ETCBTC", "ZECBTC", "XVGBTC", "QTUMBTC", "OMGBTC", "ICXBTC", "VENBTC", "BCCBTC" };
+    QVERIFY(nrSymbols <= (int)(sizeof(symbols) / sizeof(symbols[0])));
+
+    // the channels as ExchangeBinance::addPair and the routes as checkConnectWS fill them:
+    TestExchange testExchange;
+    SubscribedChannels channels;
+    Routes routes;
+    for (int i = 0; i < nrSymbols; ++i) {
+        const QString symbol(symbols[i]);
+        auto books = std::make_shared<ChannelBooks>(&testExchange, 2 * i + 1, symbol);
+        auto trades = std::make_shared<ChannelTrades>(&testExchange, 2 * i + 2, symbol, symbol);
+        channels[symbol] = std::make_pair(books, trades);
+        routes.insert(QString("%1@depth").arg(symbol.toLower()), ExchangeBinance::StreamRoute{ExchangeBinance::StreamRoute::Depth, books.get(), 0});
+        routes.insert(QString("%1@trade").arg(symbol.toLower()), ExchangeBinance::StreamRoute{ExchangeBinance::StreamRoute::Trade, 0, trades.get()});
+    }
+
+    // stream names of the messages: random symbols, about 2 depth diffs per trade
+    QStringList streams;
+    quint32 x = 12345;
+    for (int i = 0; i < NrMessages; ++i) {
+        x = x * 1664525u + 1013904223u;
+        const QString symbol = QString(symbols[(x >> 8) % nrSymbols]).toLower();
+        streams << symbol + ((x >> 20) % 3 ? "@depth" : "@trade");
+    }
+
+    // both have to find the same channels:
+    for (const QString &stream : streams)
+        QCOMPARE(dispatchRoutes(routes, stream), dispatchMap(channels, stream));
+    QCOMPARE(dispatchRoutes(routes, "btcusdt@depth"), quintptr(0));
+
+    quintptr sum = 0;
+    if (useMap) {
+        QBENCHMARK {
+            for (const QString &stream : streams)
+                sum += dispatchMap(channels, stream);
+        }
+    } else {
+        QBENCHMARK {
+            for (const QString &stream : streams)
+                sum += dispatchRoutes(routes, stream);
+        }
+    }
+    QVERIFY(sum != 0);
+}
+
+QTEST_GUILESS_MAIN(bench_Routing)
+
+#include "bench_routing.moc"
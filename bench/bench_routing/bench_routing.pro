@@ -0,0 +1,18 @@
+include(../bench.pri)
+
+QT += network websockets
+
+TARGET = bench_routing
+
+HEADERS += $$PWD/../../tests/testexchange.h \
+    $$PWD/../../exchangebinance.h \
+    $$PWD/../../exchangenam.h \
+    $$PWD/../../exchange.h \
+    $$PWD/../../channel.h \
+    $$PWD/../../streamroutes.h
+SOURCES += bench_routing.cpp \
+    $$PWD/../../exchangebinance.cpp \
+    $$PWD/../../exchangenam.cpp \
+    $$PWD/../../exchange.cpp \
+    $$PWD/../../channel.cpp \
+    $$PWD/../../roundingdouble.cpp
@@ -0,0 +1,225 @@
+#include <vector>
+#include <QtTest>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include "channel.h"
+#include "testexchange.h"
+#include "frames.h"
+#include "mapbook.h"
+
+/* applies full book snapshots (see frames.h): binance @depth20 partial depth streams,
+ * hitbtc snapshotOrderbook and bitfinex snapshot arrays, each one replacing the book.
+ * - map: the former clear() and one std::map insert per level (MapBook)
+ * - levels: the flat sides but still clear() and one handleSingleEntry per level
+ * - bulk: the channels as they are (beginBulk/appendBulk/endBulk)
+ * The frames are parsed beforehand into QJsonDocuments so only the snapshot handling
+ * (incl. the price/amount conversion from the json values) is measured.
+ */
+class bench_Snapshots : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void snapshots_data();
+    void snapshots();
+};
+
+namespace {
+
+enum Mode { Map, Levels, Bulk };
+
+class Snapshots
+{
+public:
+    QString _exchange;
+    double _tickSize;
+    std::vector<QJsonArray> _arrays; // bitfinex: the complete frame
+    std::vector<QJsonObject> _objects; // binance: data, hitbtc: params
+    std::size_t size() const { return _arrays.size() + _objects.size(); }
+};
+
+static Snapshots decode(const QString &exchange, int nrFrames)
+{
+    Snapshots s;
+    s._exchange = exchange;
+    if (exchange == "bitfinex") {
+        s._tickSize = BitfinexFrames::tickSize();
+        for (const QString &frame : BitfinexFrames::snapshots(nrFrames)) {
+            const QJsonArray data = QJsonDocument::fromJson(frame.toUtf8()).array();
+            if (data.at(1).isArray() && data.at(1).toArray().at(0).isArray())
+                s._arrays.push_back(data);
+        }
+    } else if (exchange == "binance") {
+        s._tickSize = BinanceFrames::tickSize();
+        for (const QString &frame : BinanceFrames::snapshots(nrFrames)) {
+            QJsonObject data = QJsonDocument::fromJson(frame.toUtf8()).object();
+            if (data.contains("data")) data = data["data"].toObject();
+            if (data.contains("lastUpdateId"))
+                s._objects.push_back(data);
+        }
+    } else {
+        s._tickSize = HitbtcFrames::tickSize();
+        for (const QString &frame : HitbtcFrames::snapshots(nrFrames)) {
+            const QJsonObject msg = QJsonDocument::fromJson(frame.toUtf8()).object();
+            if (msg["method"].toString() == "snapshotOrderbook")
+                s._objects.push_back(msg["params"].toObject());
+        }
+    }
+    return s;
+}
+
+class FlatBook : public ChannelBooks
+{
+public:
+    FlatBook(Exchange *exchange, const double &tickSize) :
+        ChannelBooks(exchange, BitfinexFrames::ChanId, "tBTCUSD") { setTickSize(tickSize); }
+    std::size_t nrBids() const { return _bids.size(); }
+    std::size_t nrAsks() const { return _asks.size(); }
+    double bestBid() const { return _bids.empty() ? 0.0 : toPrice(_bids.best()._price); }
+    double bestAsk() const { return _asks.empty() ? 0.0 : toPrice(_asks.best()._price); }
+
+    // the same conversions as the bulk load but one handleSingleEntry per level:
+    void bitfinexLevels(const QJsonArray &data)
+    {
+        markAlive();
+        _bids.clear();
+        _asks.clear();
+        for (const auto &l : data.at(1).toArray()) {
+            const QJsonArray a = l.toArray();
+            handleSingleEntry(toTicks(a[0].toDouble()), a[1].toInt(), a[2].toDouble());
+        }
+        done();
+    }
+    void binanceLevels(const QJsonObject &data)
+    {
+        markAlive();
+        _bids.clear();
+        for (const auto &b : data["bids"].toArray()) {
+            const QJsonArray &ba = b.toArray();
+            handleSingleEntry(toTicks(ba[0]), -1, Decimal::toDouble(ba[1]));
+        }
+        _asks.clear();
+        for (const auto &a : data["asks"].toArray()) {
+            const QJsonArray &aa = a.toArray();
+            handleSingleEntry(toTicks(aa[0]), -1, -Decimal::toDouble(aa[1]));
+        }
+        _binanceLastUpdateId = (qint64)data["lastUpdateId"].toDouble();
+        done();
+    }
+    void hitbtcLevels(const QJsonObject &data)
+    {
+        markAlive();
+        _bids.clear();
+        _asks.clear();
+        for (const auto &b : data["bid"].toArray()) {
+            const QJsonObject &bo = b.toObject();
+            handleSingleEntry(toTicks(bo["price"]), -1, Decimal::toDouble(bo["size"]));
+        }
+        for (const auto &a : data["ask"].toArray()) {
+            const QJsonObject &ao = a.toObject();
+            handleSingleEntry(toTicks(ao["price"]), -1, -Decimal::toDouble(ao["size"]));
+        }
+        done();
+    }
+private:
+    void done()
+    {
+        checkCrossed();
+        trimToMaxDepth();
+        updateTopOfBook();
+        notifyDataUpdated();
+    }
+};
+
+static void apply(MapBook &book, const Snapshots &s)
+{
+    if (s._exchange == "bitfinex") {
+        for (const auto &a : s._arrays) book.handleBitfinexSnapshot(a);
+    } else if (s._exchange == "binance") {
+        for (const auto &o : s._objects) book.handleBinanceSnapshot(o);
+    } else {
+        for (const auto &o : s._objects) book.handleHitbtcSnapshot(o);
+    }
+}
+
+static void apply(FlatBook &book, const Snapshots &s, bool bulk)
+{
+    if (s._exchange == "bitfinex") {
+        for (const auto &a : s._arrays) {
+            if (bulk) book.handleChannelData(a); else book.bitfinexLevels(a);
+        }
+    } else if (s._exchange == "binance") {
+        for (const auto &o : s._objects) {
+            if (bulk) book.handleDataFromBinance(o, true); else book.binanceLevels(o);
+        }
+    } else {
+        for (const auto &o : s._objects) {
+            if (bulk) book.handleDataFromHitbtc(o, true); else book.hitbtcLevels(o);
+        }
+    }
+}
+
+} // namespace
+
+static const int NrFrames = 5000;
+
+void bench_Snapshots::initTestCase()
+{
+    QLoggingCategory::setFilterRules("channel.debug=false"); // one line per bitfinex snapshot otherwise
+}
+
+void bench_Snapshots::snapshots_data()
+{
+    QTest::addColumn<QString>("exchange");
+    QTest::addColumn<int>("mode");
+    for (const char *exchange : { "bitfinex", "binance", "hitbtc" }) {
+        QTest::newRow(qPrintable(QString("%1 map").arg(exchange))) << QString(exchange) << (int)Map;
+        QTest::newRow(qPrintable(QString("%1 levels").arg(exchange))) << QString(exchange) << (int)Levels;
+        QTest::newRow(qPrintable(QString("%1 bulk").arg(exchange))) << QString(exchange) << (int)Bulk;
+    }
+}
+
+void bench_Snapshots::snapshots()
+{
+    QFETCH(QString, exchange);
+    QFETCH(int, mode);
+    const Snapshots s = decode(exchange, NrFrames);
+    QVERIFY(s.size() > 0);
+    TestExchange testExchange;
+
+    // all have to end up with the same book:
+    {
+        MapBook map;
+        FlatBook levels(&testExchange, s._tickSize);
+        FlatBook bulk(&testExchange, s._tickSize);
+        apply(map, s);
+        apply(levels, s, false);
+        apply(bulk, s, true);
+        QVERIFY(!map._bids.empty() && !map._asks.empty());
+        for (const FlatBook *book : { &levels, &bulk }) {
+            QCOMPARE(book->nrBids(), map._bids.size());
+            QCOMPARE(book->nrAsks(), map._asks.size());
+            QVERIFY(std::fabs(book->bestBid() - map._bids.begin()->first) < s._tickSize / 2);
+            QVERIFY(std::fabs(book->bestAsk() - map._asks.begin()->first) < s._tickSize / 2);
+        }
+    }
+
+    // one book getting all snapshots, as a channel does:
+    if (mode == Map) {
+        MapBook book;
+        QBENCHMARK {
+            apply(book, s);
+        }
+    } else {
+        FlatBook book(&testExchange, s._tickSize);
+        QBENCHMARK {
+            apply(book, s, mode == Bulk);
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(bench_Snapshots)
+
+#include "bench_snapshots.moc"
@@ -0,0 +1,13 @@
+include(../bench.pri)
+
+TARGET = bench_snapshots
+
+HEADERS += $$PWD/../../tests/testexchange.h \
+    $$PWD/../../channel.h \
+    $$PWD/../../exchange.h \
+    $$PWD/../../bookside.h \
+    $$PWD/../../decimal.h
+SOURCES += bench_snapshots.cpp \
+    $$PWD/../../channel.cpp \
+    $$PWD/../../exchange.cpp \
+    $$PWD/../../roundingdouble.cpp
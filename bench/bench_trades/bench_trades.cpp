@@ -0,0 +1,166 @@
+#include <map>
+#include <vector>
+#include <QtTest>
+#include "channel.h"
+#include "testexchange.h"
+
+/* stores a high rate trade stream (200k trades, e.g. a few minutes of a busy bitfinex
+ * or binance pair) into the ChannelTrades ring buffer and into the former
+ * std::map<int, TradesItem, std::greater<int>> with its trim loop (MapTrades below).
+ * Patterns:
+ * - unique: each id once (binance trade stream, bitFlyer executions)
+ * - te tu: bitfinex sends each trade twice, "te" and a bit later "tu" for the same id
+ * - resubscribe: every 5000 trades the last 30 ones again (snapshot after a resubscribe)
+ */
+class bench_Trades : public QObject
+{
+    Q_OBJECT
+private slots:
+    void store_data();
+    void store();
+};
+
+namespace {
+
+class Trade
+{
+public:
+    int _id;
+    long long _mts;
+    double _amount;
+    double _price;
+};
+typedef std::vector<Trade> Trades;
+
+enum Pattern { Unique, TeTu, Resubscribe };
+
+static Trades generate(Pattern pattern, int nrTrades)
+{
+    Trades trades;
+    quint32 x = 12345;
+    qint64 priceTicks = 61313; // 6131.3
+    long long mts = Q_INT64_C(1518901200000);
+    int id = 180000000;
+    while ((int)trades.size() < nrTrades) {
+        x = x * 1664525u + 1013904223u;
+        const quint32 r = x >> 8;
+        if (r % 8 == 0) priceTicks += (r & 0x100) ? 1 : -1;
+        mts += r % 40; // up to a few hundred trades per second
+        ++id;
+        trades.push_back(Trade{id, mts, (r & 0x200 ? 1.0 : -1.0) * (1 + r % 500) / 1000.0, priceTicks / 10.0});
+        if (pattern == TeTu && id > 180000004) { // the tu of one of the last few te
+            const Trade te = trades[trades.size() - 2 - (r >> 12) % 4];
+            trades.push_back(te);
+        }
+        if (pattern == Resubscribe && (trades.size() % 5000) == 0) {
+            const std::size_t n = trades.size();
+            for (std::size_t i = n - 30; i < n; ++i)
+                trades.push_back(trades[i]);
+        }
+    }
+    return trades;
+}
+
+// ChannelTrades storage before the ring buffer
+class MapTrades
+{
+public:
+    class TradesItem
+    {
+    public:
+        TradesItem(const int &id, const long long &mts,
+                   const double &amount, const double &price) :
+            _id(id), _mts(mts), _amount(amount), _price(price) {};
+        int _id;
+        long long _mts;
+        double _amount;
+        double _price;
+    };
+    typedef std::map<int, TradesItem, std::greater<int>> TradesMap;
+    TradesMap _trades;
+
+    void handleSingleEntry(const int &id, const long long &mts, const double &amount, const double &price)
+    {
+        // search whether id exists already
+        auto it = _trades.find(id);
+        if (it != _trades.end()) {
+            _trades.erase(it);
+        }
+        TradesItem item(id, mts, amount, price);
+        _trades.insert(std::make_pair(id, item));
+        // avoid keeping too many
+        while (_trades.size()>1000) {
+            _trades.erase(std::prev(_trades.end()));
+        }
+    }
+};
+
+class RingTrades : public ChannelTrades
+{
+public:
+    explicit RingTrades(Exchange *exchange) : ChannelTrades(exchange, 1, "tBTCUSD", "BTCUSD") { setTickSize(0.1); }
+    void handleSingleEntry(const Trade &t) { ChannelTrades::handleSingleEntry(t._id, t._mts, t._amount, toTicks(t._price)); }
+    quint64 nrDuplicates() const { return _nrDuplicates; }
+};
+
+} // namespace
+
+static const int NrTrades = 200000;
+
+void bench_Trades::store_data()
+{
+    QTest::addColumn<int>("pattern");
+    QTest::addColumn<bool>("useMap");
+    const char *names[] = { "unique", "te tu", "resubscribe" };
+    for (Pattern p : { Unique, TeTu, Resubscribe }) {
+        QTest::newRow(qPrintable(QString("%1 map").arg(names[p]))) << (int)p << true;
+        QTest::newRow(qPrintable(QString("%1 ring").arg(names[p]))) << (int)p << false;
+    }
+}
+
+void bench_Trades::store()
+{
+    QFETCH(int, pattern);
+    QFETCH(bool, useMap);
+    const Trades trades = generate((Pattern)pattern, NrTrades);
+    TestExchange testExchange;
+
+    // the newest 1000 have to be the same (the ring keeps a few more):
+    {
+        MapTrades map;
+        RingTrades ring(&testExchange);
+        for (const auto &t : trades) {
+            map.handleSingleEntry(t._id, t._mts, t._amount, t._price);
+            ring.handleSingleEntry(t);
+        }
+        QCOMPARE(map._trades.size(), std::size_t(1000));
+        QVERIFY(ring.trades().size() >= map._trades.size());
+        std::size_t n = ring.trades().size();
+        for (const auto &m : map._trades) {
+            const ChannelTrades::TradesItem &r = ring.trades()[--n];
+            QCOMPARE(r._id, m.first);
+            QCOMPARE(r._mts, m.second._mts);
+            QCOMPARE(r._amount, m.second._amount);
+            QCOMPARE(ring.toPrice(r._price), m.second._price);
+        }
+        QCOMPARE(ring.nrDuplicates() > 0, pattern != Unique);
+    }
+
+    if (useMap) {
+        QBENCHMARK {
+            MapTrades map;
+            for (const auto &t : trades)
+                map.handleSingleEntry(t._id, t._mts, t._amount, t._price);
+        }
+    } else {
+        QBENCHMARK {
+            RingTrades ring(&testExchange);
+            for (const auto &t : trades)
+                ring.handleSingleEntry(t);
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(bench_Trades)
+
+#include "bench_trades.moc"
@@ -0,0 +1,12 @@
+include(../bench.pri)
+
+TARGET = bench_trades
+
+HEADERS += $$PWD/../../tests/testexchange.h \
+    $$PWD/../../channel.h \
+    $$PWD/../../exchange.h \
+    $$PWD/../../ringbuffer.h
+SOURCES += bench_trades.cpp \
+    $$PWD/../../channel.cpp \
+    $$PWD/../../exchange.cpp \
+    $$PWD/../../roundingdouble.cpp
@@ -0,0 +1,328 @@
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include <cmath>
+#include <map>
+#include <vector>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+
+/* websocket frames for the benchmarks.
+ * Captured frames (one frame per line, e.g. from logging the messages received) are used if
+ * the environment variable (e.g. CRYPTOTRADER_BENCH_BINANCE) names such a file. Otherwise
+ * they are generated in the wire format of the exchanges from a deterministic random book:
+ * most changes close to the best prices, some level deletes/inserts and small moves of the mid.
+ */
+
+// lines of the file named by envName. Empty if not set or not readable
+static QStringList readFrames(const char *envName)
+{
+    QStringList frames;
+    const QString fileName = qgetenv(envName);
+    if (!fileName.length()) return frames;
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly | QFile::Text)) return frames;
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QString line = in.readLine().trimmed();
+        if (line.length()) frames << line;
+    }
+    return frames;
+}
+
+class BookGenerator
+{
+public:
+    typedef std::map<qint64, double> Levels; // price in ticks to amount (> 0)
+    class Change
+    {
+    public:
+        bool _bid;
+        qint64 _price; // ticks
+        double _amount; // new absolute amount. 0 -> deleted
+    };
+
+    BookGenerator(qint64 mid, std::size_t depth, double lot, quint32 seed = 12345) :
+        _mid(mid), _depth(depth), _lot(lot), _x(seed)
+    {
+        for (qint64 i = 1; _bids.size() < depth; ++i)
+            if (uniform() < 0.7) _bids[mid - i] = amount();
+        for (qint64 i = 1; _asks.size() < depth; ++i)
+            if (uniform() < 0.7) _asks[mid + i] = amount();
+    }
+
+    const Levels &bids() const { return _bids; }
+    const Levels &asks() const { return _asks; }
+
+    // changes of the next update message (1..maxChanges)
+    void next(int maxChanges, std::vector<Change> &changes)
+    {
+        changes.clear();
+        const int n = 1 + (int)(rnd() % maxChanges);
+        for (int i = 0; i < n; ++i) {
+            if (uniform() < 0.02) { // mid moves by one tick
+                const bool up = rnd() & 1;
+                _mid += up ? 1 : -1;
+                if (up && !_asks.empty() && _asks.begin()->first <= _mid)
+                    remove(changes, false, _asks.begin()->first);
+                if (!up && !_bids.empty() && _bids.rbegin()->first >= _mid)
+                    remove(changes, true, _bids.rbegin()->first);
+                continue;
+            }
+            const bool bid = rnd() & 1;
+            const qint64 offset = 1 + (qint64)(-std::log(1.0 - uniform()) * 4.0); // mostly within 4 ticks of the mid
+            const qint64 price = bid ? _mid - offset : _mid + offset;
+            Levels &side = bid ? _bids : _asks;
+            auto it = side.find(price);
+            if (it != side.end() && uniform() < 0.25) {
+                remove(changes, bid, price);
+            } else {
+                const double a = amount();
+                side[price] = a;
+                changes.push_back(Change{bid, price, a});
+                if (side.size() > _depth) // drop the worst one
+                    remove(changes, bid, bid ? side.begin()->first : side.rbegin()->first);
+            }
+        }
+    }
+
+private:
+    Levels _bids;
+    Levels _asks;
+    qint64 _mid;
+    std::size_t _depth;
+    double _lot;
+    quint32 _x;
+
+    quint32 rnd() { _x = _x * 1664525u + 1013904223u; return _x >> 8; } // 24 bits
+    double uniform() { return rnd() / double(1 << 24); } // 0..1
+    double amount() { return _lot * (1 + rnd() % 2000) / 100.0; }
+    void remove(std::vector<Change> &changes, bool bid, qint64 price)
+    {
+        (bid ? _bids : _asks).erase(price);
+        changes.push_back(Change{bid, price, 0.0});
+    }
+};
+
+// bitfinex book channel (P0, BTCUSD 6131.3, tick 0.1):
+// [CHANID,[PRICE,COUNT,AMOUNT],SEQ] updates and [CHANID,[[PRICE,COUNT,AMOUNT],...],SEQ] snapshots of 25 levels each
+class BitfinexFrames
+{
+public:
+    enum { ChanId = 5 };
+    static double tickSize() { return 0.1; }
+    static BookGenerator generator() { return BookGenerator(61313, 25, 1.0); }
+
+    static QString level(const BookGenerator::Change &c, quint32 count)
+    {
+        if (c._amount == 0.0)
+            return QString("[%1,0,%2]").arg(c._price * tickSize(), 0, 'f', 1).arg(c._bid ? 1 : -1);
+        return QString("[%1,%2,%3]").arg(c._price * tickSize(), 0, 'f', 1).arg(count)
+                .arg(QString::number(c._bid ? c._amount : -c._amount, 'g', 8));
+    }
+
+    static QStringList updates(int nrFrames)
+    {
+        QStringList frames = readFrames("CRYPTOTRADER_BENCH_BITFINEX");
+        if (frames.size()) return frames;
+        BookGenerator gen = generator();
+        std::vector<BookGenerator::Change> changes;
+        int seq = 1;
+        while (frames.size() < nrFrames) {
+            gen.next(1, changes); // one level per frame
+            for (const auto &c : changes) {
+                frames << QString("[%1,%2,%3]").arg((int)ChanId).arg(level(c, 1 + seq % 3)).arg(seq);
+                ++seq;
+            }
+        }
+        return frames;
+    }
+
+    static QStringList snapshots(int nrFrames)
+    {
+        QStringList frames = readFrames("CRYPTOTRADER_BENCH_BITFINEX_SNAPSHOTS");
+        if (frames.size()) return frames;
+        BookGenerator gen = generator();
+        std::vector<BookGenerator::Change> changes;
+        for (int seq = 1; frames.size() < nrFrames; ++seq) {
+            gen.next(4, changes);
+            QStringList levels;
+            for (auto it = gen.bids().rbegin(); it != gen.bids().rend(); ++it)
+                levels << level(BookGenerator::Change{true, it->first, it->second}, 1 + it->first % 3);
+            for (const auto &l : gen.asks())
+                levels << level(BookGenerator::Change{false, l.first, l.second}, 1 + l.first % 3);
+            frames << QString("[%1,[%2],%3]").arg((int)ChanId).arg(levels.join(",")).arg(seq);
+        }
+        return frames;
+    }
+};
+
+// binance BNBBTC (0.00107080, tick 0.00000001):
+// {"stream":"bnbbtc@depth","data":{"e":"depthUpdate","E":..,"s":"BNBBTC","U":..,"u":..,"b":[["PRICE","QTY",[]],...],"a":[...]}}
+// and the partial depth snapshots {"stream":"bnbbtc@depth20","data":{"lastUpdateId":..,"bids":[...],"asks":[...]}}
+class BinanceFrames
+{
+public:
+    static double tickSize() { return 0.00000001; }
+    static BookGenerator generator(std::size_t depth) { return BookGenerator(107080, depth, 10.0); }
+
+    static QString levels(const std::vector<BookGenerator::Change> &changes, bool bid)
+    {
+        QStringList l;
+        for (const auto &c : changes)
+            if (c._bid == bid)
+                l << QString("[\"%1\",\"%2\",[]]").arg(c._price * tickSize(), 0, 'f', 8).arg(c._amount, 0, 'f', 8);
+        return l.join(",");
+    }
+
+    // the snapshot to start with (as from the REST depth query) and the diffs
+    static QString restSnapshot(qint64 lastUpdateId)
+    {
+        return snapshot(generator(100), lastUpdateId, 100, false);
+    }
+    static QStringList updates(int nrFrames, qint64 lastUpdateId)
+    {
+        QStringList frames = readFrames("CRYPTOTRADER_BENCH_BINANCE");
+        if (frames.size()) return frames;
+        BookGenerator gen = generator(100);
+        std::vector<BookGenerator::Change> changes;
+        qint64 id = lastUpdateId + 1;
+        qint64 mts = Q_INT64_C(1518903528448);
+        while (frames.size() < nrFrames) {
+            do gen.next(6, changes); while (changes.empty());
+            const qint64 lastId = id + (qint64)changes.size() - 1;
+            frames << QString("{\"stream\":\"bnbbtc@depth\",\"data\":{\"e\":\"depthUpdate\",\"E\":%1,\"s\":\"BNBBTC\",\"U\":%2,\"u\":%3,\"b\":[%4],\"a\":[%5]}}")
+                      .arg(mts).arg(id).arg(lastId).arg(levels(changes, true)).arg(levels(changes, false));
+            id = lastId + 1;
+            mts += 1000;
+        }
+        return frames;
+    }
+
+    static QString snapshot(const BookGenerator &gen, qint64 lastUpdateId, std::size_t nrLevels, bool combined)
+    {
+        std::vector<BookGenerator::Change> bids;
+        std::vector<BookGenerator::Change> asks;
+        for (auto it = gen.bids().rbegin(); it != gen.bids().rend() && bids.size() < nrLevels; ++it)
+            bids.push_back(BookGenerator::Change{true, it->first, it->second});
+        for (auto it = gen.asks().begin(); it != gen.asks().end() && asks.size() < nrLevels; ++it)
+            asks.push_back(BookGenerator::Change{false, it->first, it->second});
+        const QString data = QString("{\"lastUpdateId\":%1,\"bids\":[%2],\"asks\":[%3]}")
+                .arg(lastUpdateId).arg(levels(bids, true)).arg(levels(asks, false));
+        return combined ? QString("{\"stream\":\"bnbbtc@depth%1\",\"data\":%2}").arg(nrLevels).arg(data) : data;
+    }
+    // @depth20 stream: a full snapshot of the best 20 levels every second
+    static QStringList snapshots(int nrFrames)
+    {
+        QStringList frames = readFrames("CRYPTOTRADER_BENCH_BINANCE_SNAPSHOTS");
+        if (frames.size()) return frames;
+        BookGenerator gen = generator(100);
+        std::vector<BookGenerator::Change> changes;
+        for (qint64 id = 36872610; frames.size() < nrFrames; id += 7) {
+            gen.next(12, changes);
+            frames << snapshot(gen, id, 20, true);
+        }
+        return frames;
+    }
+};
+
+// hitbtc ETHBTC (0.054590, tick 0.000001):
+// {"jsonrpc":"2.0","method":"updateOrderbook","params":{"ask":[{"price":"0.054590","size":"0.000"}],"bid":[...],"symbol":"ETHBTC","sequence":..}}
+// and snapshotOrderbook with the full book (here 100 levels each)
+class HitbtcFrames
+{
+public:
+    static double tickSize() { return 0.000001; }
+    static BookGenerator generator() { return BookGenerator(54590, 100, 1.0); }
+
+    static QString levels(const std::vector<BookGenerator::Change> &changes, bool bid)
+    {
+        QStringList l;
+        for (const auto &c : changes)
+            if (c._bid == bid)
+                l << QString("{\"price\":\"%1\",\"size\":\"%2\"}").arg(c._price * tickSize(), 0, 'f', 6).arg(c._amount, 0, 'f', 3);
+        return l.join(",");
+    }
+    static QString frame(const char *method, const std::vector<BookGenerator::Change> &changes, qint64 sequence)
+    {
+        return QString("{\"jsonrpc\":\"2.0\",\"method\":\"%1\",\"params\":{\"ask\":[%2],\"bid\":[%3],\"symbol\":\"ETHBTC\",\"sequence\":%4}}")
+                .arg(method).arg(levels(changes, false)).arg(levels(changes, true)).arg(sequence);
+    }
+    static QString snapshot(const BookGenerator &gen, qint64 sequence)
+    {
+        std::vector<BookGenerator::Change> all;
+        for (auto it = gen.asks().begin(); it != gen.asks().end(); ++it)
+            all.push_back(BookGenerator::Change{false, it->first, it->second});
+        for (auto it = gen.bids().rbegin(); it != gen.bids().rend(); ++it)
+            all.push_back(BookGenerator::Change{true, it->first, it->second});
+        return frame("snapshotOrderbook", all, sequence);
+    }
+
+    static QStringList updates(int nrFrames)
+    {
+        QStringList frames = readFrames("CRYPTOTRADER_BENCH_HITBTC");
+        if (frames.size()) return frames;
+        BookGenerator gen = generator();
+        std::vector<BookGenerator::Change> changes;
+        frames << snapshot(gen, 1);
+        for (qint64 seq = 2; frames.size() < nrFrames; ++seq) {
+            do gen.next(4, changes); while (changes.empty());
+            frames << frame("updateOrderbook", changes, seq);
+        }
+        return frames;
+    }
+    static QStringList snapshots(int nrFrames)
+    {
+        QStringList frames = readFrames("CRYPTOTRADER_BENCH_HITBTC_SNAPSHOTS");
+        if (frames.size()) return frames;
+        BookGenerator gen = generator();
+        std::vector<BookGenerator::Change> changes;
+        for (qint64 seq = 1; frames.size() < nrFrames; ++seq) {
+            gen.next(12, changes);
+            frames << snapshot(gen, seq);
+        }
+        return frames;
+    }
+};
+
+// bitFlyer FX_BTC_JPY executions, 1-5 per frame:
+// {"jsonrpc":"2.0","method":"channelMessage","params":{"channel":"lightning_executions_FX_BTC_JPY","message":[{"id":..,"side":"BUY",
+//  "price":940129,"size":0.001,"exec_date":"2017-11-24T22:13:29.1301581Z","buy_child_order_acceptance_id":"JRF..","sell_child_order_acceptance_id":"JRF.."}]}}
+class BitFlyerFrames
+{
+public:
+    static QStringList executions(int nrFrames)
+    {
+        QStringList frames = readFrames("CRYPTOTRADER_BENCH_BITFLYER");
+        if (frames.size()) return frames;
+        quint32 x = 12345;
+        int id = 75526868;
+        int price = 940129;
+        qint64 us = 0; // since 22:13:00
+        while (frames.size() < nrFrames) {
+            x = x * 1664525u + 1013904223u;
+            QStringList execs;
+            for (int n = 1 + (x >> 8) % 5; n > 0; --n) {
+                x = x * 1664525u + 1013904223u;
+                const bool sell = (x >> 9) & 1;
+                price += sell ? -(int)((x >> 12) % 3) : (int)((x >> 12) % 3);
+                us += (x >> 14) % 200000;
+                const int sec = (int)(us / 1000000);
+                ++id;
+                const QString date = QString("2017-11-24T22:%1:%2.%3Z").arg(13 + sec / 60 % 40, 2, 10, QChar('0'))
+                        .arg(sec % 60, 2, 10, QChar('0')).arg((int)(us % 1000000) * 10 + (int)(x % 10), 7, 10, QChar('0'));
+                execs << QString("{\"id\":%1,\"side\":\"%2\",\"price\":%3,\"size\":%4,\"exec_date\":\"%5\","
+                                 "\"buy_child_order_acceptance_id\":\"JRF20171124-221326-%6\",\"sell_child_order_acceptance_id\":\"JRF20171125-071316-%7\"}")
+                         .arg(id).arg(sell ? "SELL" : "BUY").arg(price).arg(QString::number(0.001 * (1 + (x >> 16) % 500), 'g', 6))
+                         .arg(date).arg(585479 + id % 1000, 6, 10, QChar('0')).arg(913089 + id % 997, 6, 10, QChar('0'));
+            }
+            frames << QString("{\"jsonrpc\":\"2.0\",\"method\":\"channelMessage\",\"params\":{\"channel\":\"lightning_executions_FX_BTC_JPY\",\"message\":[%1]}}")
+                      .arg(execs.join(","));
+        }
+        return frames;
+    }
+};
+
+#endif // FRAMES_H
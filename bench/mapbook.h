@@ -0,0 +1,157 @@
+#ifndef MAPBOOK_H
+#define MAPBOOK_H
+
+#include <map>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+
+/* ChannelBooks before the flat book (BookSide): std::map with a function pointer compare,
+ * double prices and the snapshots applied level by level after a clear().
+ * Only kept as the baseline for the benchmarks.
+ */
+class MapBook
+{
+public:
+    MapBook() : _bids(greater), _asks(less), _symbol("tBTCUSD") {}
+
+    class BookItem
+    {
+    public:
+        BookItem(const double &p, const int &c, const double &a) :
+            _price(p), _count(c), _amount(a) {};
+        double _price;
+        int _count;
+        double _amount;
+    };
+    typedef std::map<double, BookItem, bool(*)(const double&, const double&)> BookItemMap;
+    BookItemMap _bids;
+    BookItemMap _asks;
+    QString _symbol;
+
+    static bool greater(const double &a, const double &b) { return a>b; }
+    static bool less(const double &a, const double &b) { return a<b; }
+
+    void handleSingleEntry(const double &price, const int &count, const double &amount)
+    { // count == -1 -> set value abs and don't add rel.
+        bool isFunding = _symbol.startsWith("f");
+        bool isBid = (isFunding ? (amount<0) : (amount>0));
+        BookItemMap &map = isBid ? _bids : _asks;
+        auto it = map.find(price);
+        if (count==0) {
+            if (it != map.end())
+                map.erase(it);
+        } else {
+            if (it != map.end()) {
+                BookItem &bookItem = it->second;
+                if (count == -1) {
+                    bookItem._count = 1;
+                    bookItem._amount = amount;
+                } else {
+                    bookItem._count += count;
+                    bookItem._amount += amount;
+                }
+                if (bookItem._amount == 0.0)
+                    map.erase(it);
+            } else {
+                if (amount != 0.0) {
+                    BookItem bookItem(price, count==-1 ? 1 : count, amount);
+                    map.insert(std::make_pair(price,bookItem));
+                }
+            }
+        }
+    }
+
+    // [CHANID,[[PRICE,COUNT,AMOUNT],...],SEQ]. The former code didn't clear the book here
+    // (only fresh subscriptions got a snapshot) so the clear() is added to compare the same result.
+    void handleBitfinexSnapshot(const QJsonArray &data)
+    {
+        _bids.clear();
+        _asks.clear();
+        for (auto a : data.at(1).toArray()) {
+            if (a.isArray() && a.toArray().count()==3) {
+                double price = a.toArray()[0].toDouble();
+                int count = a.toArray()[1].toInt();
+                double amount = a.toArray()[2].toDouble();
+                handleSingleEntry(price, count, amount);
+            }
+        }
+    }
+
+    // {"lastUpdateId":..,"bids":[["PRICE","QTY",[]],...],"asks":[...]}
+    void handleBinanceSnapshot(const QJsonObject &data)
+    {
+        _bids.clear();
+        for (const auto &b : data["bids"].toArray()) {
+            if (b.isArray()) {
+                const QJsonArray &ba = b.toArray();
+                double price = ba[0].toString().toDouble();
+                double quantity = ba[1].toString().toDouble();
+                _bids.insert(std::make_pair(price, BookItem(price, 1, quantity)));
+            }
+        }
+        _asks.clear();
+        for (const auto &a : data["asks"].toArray()) {
+            if (a.isArray()) {
+                const QJsonArray &ba = a.toArray();
+                double price = ba[0].toString().toDouble();
+                double quantity = ba[1].toString().toDouble();
+                _asks.insert(std::make_pair(price, BookItem(price, 1, -quantity)));
+            }
+        }
+    }
+
+    // params of snapshotOrderbook: {"ask":[{"price":"..","size":".."},...],"bid":[...],..}
+    void handleHitbtcSnapshot(const QJsonObject &data)
+    {
+        _bids.clear();
+        _asks.clear();
+        for (const auto &b : data["bid"].toArray()) {
+            if (b.isObject()) {
+                const QJsonObject &bo = b.toObject();
+                double price = bo["price"].toString().toDouble();
+                double size = bo["size"].toString().toDouble();
+                handleSingleEntry(price, size==0.0 ? 0 : -1, size == 0.0 ? 1.0 : size);
+            }
+        }
+        for (const auto &a : data["ask"].toArray()) {
+            if (a.isObject()) {
+                const QJsonObject &bo = a.toObject();
+                double price = bo["price"].toString().toDouble();
+                double size = bo["size"].toString().toDouble();
+                handleSingleEntry(price, size==0.0 ? 0 : -1, -size);
+            }
+        }
+    }
+
+    bool getPrices(bool ask, const double &amount, double &avg, double &limit, double *maxAmount=0) const
+    {
+        const BookItemMap &map = ask ? _asks : _bids;
+        if (amount <= 0.0) {
+            if (maxAmount) *maxAmount = 0.0;
+            return false;
+        }
+        double volume = 0.0;
+        double retLimit = 0.0;
+        double gotAmount = 0.0;
+        double needAmount = amount;
+        for (const auto &item : map) {
+            double amountAvail = item.second._amount;
+            if (ask) amountAvail = -amountAvail;
+            double consume = amountAvail > needAmount ? needAmount : amountAvail;
+            volume += consume * item.second._price;
+            retLimit = item.second._price;
+            gotAmount += consume;
+            if (gotAmount >= amount) break;
+        }
+        if (maxAmount) *maxAmount = gotAmount;
+        if (gotAmount >= amount) {
+            avg = volume / gotAmount;
+            limit = retLimit;
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif // MAPBOOK_H
@@ -0,0 +1,222 @@
+#ifndef BOOKSIDE_H
+#define BOOKSIDE_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+/* one side (bids or asks) of an order book kept in a contiguous sorted vector.
+ * The levels are stored from worst to best price so that the best price is at the
+ * back of the vector. Nearly all updates hit the first few levels so inserts/erases
+ * there only move a few elements and lookups start at the hot end.
+ * Better(a,b) returns true if price a is better than price b (bids: greater, asks: less).
+ * Iteration (begin/end) is from best to worst price like with the former std::map.
+ *
+ * Additionally the cumulative amount and notional (price * abs(amount)) from the worst
+ * level up to each level are kept. Changes only invalidate the sums from the changed
+ * level towards the best one (so usually just a few entries) and they are recalculated
+ * lazily on the next depth query. Levels must be modified via modify() to keep them valid.
+ *
+ * trim() bounds the number of levels by dropping the worst ones. Afterwards the side is
+ * "truncated": levels at or beyond the worst dropped price might be missing until the
+ * next clear()/bulk load (see incompleteAt()).
+ */
+template <class Price, class Item, class Better>
+class BookSide
+{
+public:
+    typedef typename std::vector<Item>::const_reverse_iterator const_iterator;
+
+    const_iterator begin() const { return _levels.crbegin(); }
+    const_iterator end() const { return _levels.crend(); }
+
+    std::size_t size() const { return _levels.size(); }
+    bool empty() const { return _levels.empty(); }
+    void clear() { _levels.clear(); _cumValid = 0; _truncated = false; } // keeps the capacity
+
+    const Item &best() const { return _levels.back(); } // must not be empty
+    void eraseBest() { _levels.pop_back(); invalidate(_levels.size()); }
+
+    const Item *find(const Price &price) const
+    {
+        std::size_t pos = position(price);
+        if (pos < _levels.size() && _levels[pos]._price == price)
+            return &_levels[pos];
+        return 0;
+    }
+
+    // write access to a level from find()/best()
+    Item &modify(const Item *item)
+    {
+        std::size_t pos = item - _levels.data();
+        invalidate(pos);
+        return _levels[pos];
+    }
+
+    // insert or return the existing level for item._price
+    Item &insert(const Item &item)
+    {
+        std::size_t pos = position(item._price);
+        invalidate(pos);
+        if (pos < _levels.size() && _levels[pos]._price == item._price)
+            return _levels[pos];
+        return *_levels.insert(_levels.begin() + pos, item);
+    }
+
+    bool erase(const Price &price)
+    {
+        std::size_t pos = position(price);
+        if (pos < _levels.size() && _levels[pos]._price == price) {
+            _levels.erase(_levels.begin() + pos);
+            invalidate(pos);
+            return true;
+        }
+        return false;
+    }
+
+    void erase(const Item *item) // item from find()
+    {
+        std::size_t pos = item - _levels.data();
+        _levels.erase(_levels.begin() + pos);
+        invalidate(pos);
+    }
+
+    /* bulk load of a whole side, e.g. from a snapshot. Reuses the storage:
+     * beginBulk(), appendBulk() for each level in any order (no empty ones), endBulk().
+     * Levels with the same price are merged (_count and _amount added) */
+    void beginBulk() { clear(); }
+    void appendBulk(const Item &item) { _levels.push_back(item); }
+    void endBulk()
+    {
+        Better better;
+        auto worse = [&better](const Item &a, const Item &b) { return better(b._price, a._price); };
+        if (!std::is_sorted(_levels.begin(), _levels.end(), worse)) {
+            // exchanges usually send the best price first:
+            std::reverse(_levels.begin(), _levels.end());
+            if (!std::is_sorted(_levels.begin(), _levels.end(), worse))
+                std::stable_sort(_levels.begin(), _levels.end(), worse);
+        }
+        auto samePrice = [](const Item &a, const Item &b) { return a._price == b._price; };
+        auto dup = std::adjacent_find(_levels.begin(), _levels.end(), samePrice);
+        if (dup == _levels.end()) return; // the usual case
+        auto to = dup;
+        for (auto it = dup + 1; it != _levels.end(); ++it) {
+            if (it->_price == to->_price) {
+                to->_count += it->_count;
+                to->_amount += it->_amount;
+            } else
+                *++to = *it;
+        }
+        _levels.erase(to + 1, _levels.end());
+    }
+
+    // apply f to each level. f must not change the order.
+    template <class F>
+    void transform(F f)
+    {
+        for (auto &item : _levels)
+            f(item);
+        if (_truncated) f(_trimBound);
+        _cumValid = 0;
+    }
+
+    // keep at most maxLevels (the best ones). returns the number of levels removed.
+    std::size_t trim(std::size_t maxLevels)
+    {
+        if (_levels.size() <= maxLevels) return 0;
+        std::size_t toRemove = _levels.size() - maxLevels;
+        const Item &bestRemoved = _levels[toRemove-1];
+        if (!_truncated || Better()(bestRemoved._price, _trimBound._price))
+            _trimBound = bestRemoved;
+        _truncated = true;
+        _levels.erase(_levels.begin(), _levels.begin() + toRemove);
+        _cumValid = 0; // the sums start at the worst level
+        return toRemove;
+    }
+    bool truncated() const { return _truncated; }
+    // might levels at price or worse be missing due to trim()?
+    bool incompleteAt(const Price &price) const { return _truncated && !Better()(price, _trimBound._price); }
+
+    double totalAmount() const { update(); return _levels.empty() ? 0.0 : _cumAmount.back(); }
+
+    /* take amount starting from the best level.
+     * returns false if less than amount is available. gotAmount and notional are then
+     * the totals of the whole side and limit the worst price.
+     * Otherwise gotAmount==amount, notional the sum of price*amount taken and limit
+     * the price of the worst level needed. O(log n) */
+    bool take(const double &amount, double &gotAmount, double &notional, Price &limit) const
+    {
+        update();
+        const std::size_t n = _levels.size();
+        if (!n) {
+            gotAmount = 0.0;
+            notional = 0.0;
+            return false;
+        }
+        const double total = _cumAmount.back();
+        const double totalNotional = _cumNotional.back();
+        if (total < amount) {
+            gotAmount = total;
+            notional = totalNotional;
+            limit = _levels.front()._price;
+            return false;
+        }
+        // levels [k+1, n) are taken fully and level k partly:
+        std::size_t k = std::upper_bound(_cumAmount.begin(), _cumAmount.end(), total - amount) - _cumAmount.begin();
+        if (k >= n) k = n - 1;
+        double fullAmount = total - _cumAmount[k];
+        double fullNotional = totalNotional - _cumNotional[k];
+        gotAmount = amount;
+        notional = fullNotional + (amount - fullAmount) * _levels[k]._price;
+        limit = _levels[k]._price;
+        return true;
+    }
+
+private:
+    // index of the first level that is not worse than price (i.e. price or better)
+    std::size_t position(const Price &price) const
+    {
+        Better better;
+        std::size_t pos = _levels.size();
+        // probe the hot end linearly first:
+        for (int i=0; i<8 && pos>0; ++i) {
+            if (better(price, _levels[pos-1]._price))
+                return pos;
+            --pos;
+        }
+        auto it = std::partition_point(_levels.begin(), _levels.begin() + pos,
+                                       [&better, &price](const Item &item){ return better(price, item._price); });
+        return it - _levels.begin();
+    }
+
+    void invalidate(std::size_t pos) { if (pos < _cumValid) _cumValid = pos; }
+
+    void update() const // recalc the invalid cumulative sums
+    {
+        const std::size_t n = _levels.size();
+        if (_cumValid >= n && _cumAmount.size() == n) return;
+        _cumAmount.resize(n);
+        _cumNotional.resize(n);
+        double amount = _cumValid ? _cumAmount[_cumValid-1] : 0.0;
+        double notional = _cumValid ? _cumNotional[_cumValid-1] : 0.0;
+        for (std::size_t i = _cumValid; i < n; ++i) {
+            const Item &item = _levels[i];
+            double a = std::fabs(item._amount);
+            amount += a;
+            notional += a * item._price;
+            _cumAmount[i] = amount;
+            _cumNotional[i] = notional;
+        }
+        _cumValid = n;
+    }
+
+    std::vector<Item> _levels; // worst ... best
+    bool _truncated = false;
+    Item _trimBound; // best level removed by trim(). valid if _truncated
+    mutable std::vector<double> _cumAmount; // sum of abs(amount) of levels [0, i]
+    mutable std::vector<double> _cumNotional; // sum of price * abs(amount) of levels [0, i]
+    mutable std::size_t _cumValid = 0; // cum... valid for [0, _cumValid)
+};
+
+#endif // BOOKSIDE_H
@@ -0,0 +1,117 @@
+#ifndef CANDLESERIES_H
+#define CANDLESERIES_H
+
+#include <vector>
+#include <cstddef>
+#include <cassert>
+
+/* bounded series of candles (Item with a _close member) ordered by their Key (open time),
+ * oldest at index 0 and newest at size()-1 (back()). Once the capacity is reached the
+ * oldest candle is dropped.
+ * The close prices are mirrored into an array of twice the capacity (each value is
+ * written at p and p+capacity) so that the last n closes are always contiguous and
+ * can be passed to indicator code without copying (lastCloses()).
+ * Items need to be modified via modify() to keep the closes in sync.
+ */
+template <class Key, class Item>
+class CandleSeries
+{
+public:
+    explicit CandleSeries(std::size_t capacity) : _mask(0), _head(0)
+    {
+        std::size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        _mask = cap - 1;
+        _keys.reserve(cap);
+        _items.reserve(cap);
+        _closes.resize(2 * cap);
+    }
+
+    std::size_t capacity() const { return _mask + 1; }
+    std::size_t size() const { return _items.size(); }
+    bool empty() const { return _items.empty(); }
+
+    const Item &operator[](std::size_t i) const { assert(i < size()); return _items[phys(i)]; }
+    const Key &key(std::size_t i) const { assert(i < size()); return _keys[phys(i)]; }
+    const Item &back() const { return (*this)[size() - 1]; } // newest. must not be empty
+    const Key &backKey() const { return key(size() - 1); }
+
+    // closes of the newest n candles, oldest first. n <= size()
+    const double *lastCloses(std::size_t n) const
+    {
+        assert(n <= size());
+        return &_closes[phys(size() - n)];
+    }
+
+    // apply f(Item &) to the candle at index i
+    template <class F>
+    void modify(std::size_t i, F f)
+    {
+        std::size_t p = phys(i);
+        f(_items[p]);
+        syncClose(p);
+    }
+
+    // index of the candle with key k
+    bool find(const Key &k, std::size_t &index) const
+    {
+        std::size_t lo = 0, hi = size();
+        while (lo < hi) {
+            std::size_t mid = (lo + hi) / 2;
+            if (key(mid) < k) lo = mid + 1; else hi = mid;
+        }
+        if (lo < size() && !(k < key(lo))) {
+            index = lo;
+            return true;
+        }
+        return false;
+    }
+
+    /* add a new candle. Usually the newest one (O(1)). Older ones are inserted in place (O(n)).
+     * returns false if it's older than all candles kept and the series is full. k must not exist yet */
+    bool insert(const Key &k, const Item &item)
+    {
+        // find the position (first with key > k), starting from the newest:
+        std::size_t pos = size();
+        while (pos > 0 && k < key(pos - 1)) --pos;
+        if (size() == capacity()) {
+            if (pos == 0) return false; // too old
+            // drop the oldest. Its slot becomes the newest one:
+            _head = (_head + 1) & _mask;
+            --pos;
+        } else {
+            _keys.push_back(k); // grow by one. (values set below)
+            _items.push_back(item);
+        }
+        // move the newer ones up by one:
+        for (std::size_t i = size() - 1; i > pos; --i) {
+            std::size_t to = phys(i), from = phys(i - 1);
+            _keys[to] = _keys[from];
+            _items[to] = _items[from];
+            syncClose(to);
+        }
+        std::size_t p = phys(pos);
+        _keys[p] = k;
+        _items[p] = item;
+        syncClose(p);
+        return true;
+    }
+
+private:
+    std::size_t phys(std::size_t i) const { return (_head + i) & _mask; }
+
+    void syncClose(std::size_t p)
+    {
+        double c = _items[p]._close;
+        _closes[p] = c;
+        _closes[p + capacity()] = c;
+    }
+
+    std::vector<Key> _keys;
+    std::vector<Item> _items;
+    std::vector<double> _closes; // 2 * capacity
+    std::size_t _mask;
+    std::size_t _head; // physical index of the oldest once full
+};
+
+#endif // CANDLESERIES_H
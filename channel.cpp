@@ -1,9 +1,12 @@
+#include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <limits>
 #include <QDateTime>
 #include <QDebug>
 #include <QJsonValueRef>
 #include <QTextStream>
+#include <QTimer>
 
 #include "channel.h"
 #include "exchange.h"
@@ -11,9 +14,11 @@
 Q_LOGGING_CATEGORY(Cchannel, "channel")
 
 Channel::Channel(Exchange *exchange, int id, const QString &name, const QString &symbol, const QString &pair, bool subscribed) :
+    _notifyPending(false), _minNotifyIntervalMs(0), _lastNotifyMs(0), _nrNotifies(0), _nrMergedNotifies(0),
     _exchange(exchange),
     _timeoutMs(60000), _isSubscribed(subscribed), _isTimeout(false), _id(id), _channel(name), _symbol(symbol), _pair(pair)
   , _lastMsg(QDateTime::currentDateTime()) // we need to fill with now otherwise first timeout is after 1s and not after defined timeout
+  , _ticksPerUnit(1e8) // 1 satoshi as default. exchanges set the pair specific one via setTickSize
 {
     qCDebug(Cchannel) << __PRETTY_FUNCTION__ << _id << _channel << _symbol << _pair << _isSubscribed;
     assert(_exchange);
@@ -42,6 +47,53 @@ Channel::~Channel()
     qCDebug(Cchannel) << __PRETTY_FUNCTION__ << _id;
 }
 
+void Channel::notifyDataUpdated()
+{
+    ++_nrNotifies;
+    if (_notifyPending) {
+        ++_nrMergedNotifies;
+        return;
+    }
+    _notifyPending = true;
+    if (_minNotifyIntervalMs) {
+        qint64 delay = _lastNotifyMs + _minNotifyIntervalMs - QDateTime::currentMSecsSinceEpoch();
+        if (delay > 0) {
+            QTimer::singleShot((int)delay, this, SLOT(emitDataUpdated()));
+            return;
+        }
+    }
+    // at the end of the current event loop turn (i.e. after the pending ws messages):
+    QMetaObject::invokeMethod(this, "emitDataUpdated", Qt::QueuedConnection);
+}
+
+void Channel::emitDataUpdated()
+{
+    _notifyPending = false;
+    _lastNotifyMs = QDateTime::currentMSecsSinceEpoch();
+    emit dataUpdated();
+}
+
+void Channel::setTickSize(const double &tickSize)
+{
+    assert(tickSize > 0.0);
+    qCDebug(Cchannel) << __PRETTY_FUNCTION__ << _id << _symbol << tickSize;
+    double ticksPerUnit = 1.0 / tickSize;
+    if (std::fabs(ticksPerUnit - std::round(ticksPerUnit)) < 1e-6)
+        ticksPerUnit = std::round(ticksPerUnit); // e.g. 0.00000100 -> exactly 1000000
+    _ticksPerUnit = ticksPerUnit;
+}
+
+qint64 Channel::toTicks(const QJsonValue &price) const
+{
+    if (price.isString()) {
+        Decimal d;
+        const QString &str = price.toString();
+        if (d.parse(str)) return toTicks(d);
+        return toTicks(str.toDouble());
+    }
+    return toTicks(price.toDouble());
+}
+
 void Channel::subscribed()
 {
     qCDebug(Cchannel) << __PRETTY_FUNCTION__ << "was subscribed=" << _isSubscribed;
@@ -64,12 +116,7 @@ bool Channel::handleChannelData(const QJsonArray &data)
         qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "data but not subscribed" << data;
     }
     assert(_id == data.at(0).toInt());
-    _lastMsg = QDateTime::currentDateTime(); // or UTC?
-    if (_isTimeout) {
-        _isTimeout = false;
-        qCWarning(Cchannel) << "channel (" << _id << _channel << _symbol << _pair << ") seems back!";
-        emit timeout(_id, _isTimeout);
-    }
+    markAlive();
     // todo we might only handle ping alive msgs here. The rest needs to be done by overriden members
     // for now simply return true;
     return true;
@@ -90,6 +137,26 @@ bool Channel::handleChannelData(const QJsonArray &data)
     */
 }
 
+void Channel::markAlive()
+{
+    _lastMsg = QDateTime::currentDateTime(); // or UTC?
+    if (_isTimeout) {
+        _isTimeout = false;
+        qCWarning(Cchannel) << "channel (" << _id << _channel << _symbol << _pair << ") seems back!";
+        emit timeout(_id, _isTimeout);
+    }
+}
+
+bool Channel::handleBitfinexUpdate(const BitfinexUpdate &update)
+{
+    (void)update;
+    if (!_isSubscribed) {
+        qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "data but not subscribed" << _id;
+    }
+    markAlive();
+    return true;
+}
+
 bool Channel::handleDataFromBitFlyer(const QJsonObject &data)
 {
     (void)data;
@@ -128,23 +195,23 @@ bool Channel::handleDataFromHitbtc(const QJsonObject &data, bool complete)
     return true;
 }
 
-bool greater(const double &a, const double &b)
-{
-    return a>b;
-}
-
-bool less(const double &a, const double &b)
-{
-    return a<b;
-}
-
 ChannelBooks::ChannelBooks(Exchange *exchange, int id, const QString &symbol) :
     Channel(exchange, id, QString("book"), symbol, QString()),
-    _bids(greater),
-   _asks(less),
-   _bitFlyerGotSnapshot(false)
+   _top(),
+   _maxDepth(0),
+   _snapshotTmp(),
+   _bitFlyerGotSnapshot(false),
+   _snapshotRequested(false),
+   _snapshotRetryMs(0),
+   _isCrossed(false),
+   _isDiffStream(false),
+   _binanceLastUpdateId(0),
+   _binanceDiffs(1024),
+   _binanceReplay(1024)
 {
     qCDebug(Cchannel) << __PRETTY_FUNCTION__ << _id << _channel << _symbol;
+    _snapshotRetryTimer.setSingleShot(true);
+    connect(&_snapshotRetryTimer, &QTimer::timeout, this, [this]() { _snapshotRequested = false; }); // the next update asks again
 }
 
 ChannelBooks::~ChannelBooks()
@@ -153,9 +220,56 @@ ChannelBooks::~ChannelBooks()
 }
 
 bool ChannelBooks::handleChannelData(const QJsonArray &data)
+{
+    return handleBitfinexData<TradingPolicy>(data);
+}
+
+bool ChannelBooks::TradingPolicy::parse(const Channel &ch, const QJsonArray &a, BookItem &item)
+{
+    if (a.count() != 3) return false;
+    item._price = ch.toTicks(a[0].toDouble());
+    item._count = a[1].toInt();
+    item._period = 0;
+    item._amount = a[2].toDouble();
+    return true;
+}
+
+bool ChannelBooks::TradingPolicy::parse(const Channel &ch, const double *v, int n, BookItem &item)
+{
+    if (n != 3) return false;
+    item._price = ch.toTicks(v[0]);
+    item._count = (int)v[1];
+    item._period = 0;
+    item._amount = v[2];
+    return true;
+}
+
+bool ChannelBooks::FundingPolicy::parse(const Channel &ch, const double *v, int n, BookItem &item)
+{
+    if (n != 4) return false;
+    item._price = ch.toTicks(v[0]); // rate
+    item._period = (int)v[1];
+    item._count = (int)v[2];
+    item._amount = v[3];
+    return true;
+}
+
+bool ChannelBooks::FundingPolicy::parse(const Channel &ch, const QJsonArray &a, BookItem &item)
+{
+    if (a.count() != 4) return false;
+    item._price = ch.toTicks(a[0].toDouble()); // rate
+    item._period = a[1].toInt();
+    item._count = a[2].toInt();
+    item._amount = a[3].toDouble();
+    return true;
+}
+
+template <class Policy>
+bool ChannelBooks::handleBitfinexData(const QJsonArray &data)
 {
     //qCDebug(Cchannel) << __PRETTY_FUNCTION__ << data;
     if (Channel::handleChannelData(data)) {
+        typename Policy::Book &book = static_cast<typename Policy::Book &>(*this);
         const QJsonValue &actionValue = data.at(1);
         if (actionValue.isString()) {
             auto action = actionValue.toString();
@@ -170,18 +284,20 @@ bool ChannelBooks::handleChannelData(const QJsonArray &data)
                     qCDebug(Cchannel) << _id << "array of " << actionValue.toArray().count() << "arrays";
                     if (actionValue.toArray().count()>=50) // we expect at least twice the "len" param. (todo use param)
                         _bitFlyerGotSnapshot = true;
+                    // that's the snapshot: replace both sides in one go
+                    snapshotReceived();
+                    book.beginSnapshot();
+                    BookItem item;
                     for (auto a : actionValue.toArray()) {
                         // qCDebug(Cchannel) << a;
                         if (a.isArray()) {
-                            if (a.toArray().count()==3) {
-                                // for books: price, count, amount
-                                double price = a.toArray()[0].toDouble();
-                                int count = a.toArray()[1].toInt();
-                                double amount = a.toArray()[2].toDouble();
-                                handleSingleEntry(price, count, amount);
+                            if (Policy::parse(*this, a.toArray(), item)) {
+                                if (item._count == 0 || item._amount == 0.0) continue;
+                                book.addSnapshotLevel(item);
                             } else qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "array elem with unknown data" << a;
                         } else qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "don't know how to handle" << a << data;
                     }
+                    book.endSnapshot();
                 } else {
                     if (!_bitFlyerGotSnapshot) {
                         // we ignore it and wait for snapshot first
@@ -189,23 +305,73 @@ bool ChannelBooks::handleChannelData(const QJsonArray &data)
                         return true;
                     }
                     // array of objects, so single update
-                    // for books: price, count, amount
-                    //
                     //qCDebug(Cchannel) << data;
-                    const auto &a = actionValue.toArray();
-                    double price = a[0].toDouble();
-                    int count = a[1].toInt();
-                    double amount = a[2].toDouble();
-                    handleSingleEntry(price, count, amount);
+                    BookItem item;
+                    if (Policy::parse(*this, actionValue.toArray(), item))
+                        book.applyLevel(item);
+                    else qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "unknown data" << data;
                 }
                 //qCDebug(Cchannel) << "bids count=" << _bids.size() << " asks count=" << _asks.size();
                 //printAsksBids();
+                if (!Policy::CanCross) checkCrossed();
+                trimToMaxDepth();
+                updateTopOfBook();
             }
-        emit dataUpdated();
+        notifyDataUpdated();
         return true;
     } else return false;
 }
 
+template <class Policy>
+bool ChannelBooks::applyBitfinexUpdate(const BitfinexUpdate &update)
+{ // same as the single update within handleBitfinexData
+    if (!Channel::handleBitfinexUpdate(update)) return false;
+    if (update._kind == BitfinexUpdate::Values) {
+        if (!_bitFlyerGotSnapshot) {
+            qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "still waiting for snapshot. ignored" << _id;
+            return true;
+        }
+        BookItem item;
+        if (Policy::parse(*this, update._values, update._nrValues, item))
+            static_cast<typename Policy::Book &>(*this).applyLevel(item);
+        else qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "unknown data" << _id << update._nrValues;
+        if (!Policy::CanCross) checkCrossed();
+        trimToMaxDepth();
+        updateTopOfBook();
+    }
+    notifyDataUpdated();
+    return true;
+}
+
+bool ChannelBooks::handleBitfinexUpdate(const BitfinexUpdate &update)
+{
+    return applyBitfinexUpdate<TradingPolicy>(update);
+}
+
+void ChannelBooks::applyLevel(const BookItem &item)
+{
+    handleSingleEntry<TradingPolicy>(item._price, item._count, item._amount);
+}
+
+void ChannelBooks::beginSnapshot()
+{
+    _bids.beginBulk();
+    _asks.beginBulk();
+}
+
+void ChannelBooks::addSnapshotLevel(const BookItem &item)
+{
+    if (TradingPolicy::isBid(item._amount))
+        _bids.appendBulk(item);
+    else
+        _asks.appendBulk(item);
+}
+
+void ChannelBooks::endSnapshot()
+{
+    _bids.endBulk();
+    _asks.endBulk();
+}
 
 void ChannelBooks::unsubscribed()
 {
@@ -215,6 +381,42 @@ void ChannelBooks::unsubscribed()
     _bids.clear();
     _asks.clear();
     _bitFlyerGotSnapshot = false;
+    _snapshotRequested = false;
+    _snapshotRetryTimer.stop();
+    _snapshotRetryMs = 0;
+    _isCrossed = false;
+    _binanceLastUpdateId = 0;
+    _binanceDiffs.clear();
+    updateTopOfBook();
+}
+
+void ChannelBooks::requestSnapshot()
+{
+    if (_snapshotRequested) return; // book is empty already and we just wait for the snapshot
+    qCDebug(Cchannel) << __PRETTY_FUNCTION__ << _id << _symbol;
+    _bids.clear();
+    _asks.clear();
+    _bitFlyerGotSnapshot = false; // ignore the (bitfinex, bitFlyer) updates until the snapshot
+    _binanceLastUpdateId = 0; // buffer the diffs until the snapshot arrives
+    updateTopOfBook();
+    _snapshotRequested = true;
+    emit snapshotNeeded(_id);
+}
+
+void ChannelBooks::snapshotRequestFailed()
+{
+    // keep _snapshotRequested until the backoff expired. Otherwise each update (e.g. each
+    // binance diff) would trigger the next request:
+    _snapshotRetryMs = _snapshotRetryMs ? std::min(2 * _snapshotRetryMs, 60000) : 1000;
+    qCWarning(Cchannel) << __PRETTY_FUNCTION__ << _id << _symbol << "asking again in" << _snapshotRetryMs << "ms";
+    _snapshotRetryTimer.start(_snapshotRetryMs);
+}
+
+void ChannelBooks::snapshotReceived()
+{
+    _snapshotRequested = false;
+    _snapshotRetryTimer.stop();
+    _snapshotRetryMs = 0;
 }
 
 bool ChannelBooks::handleDataFromBitFlyer(const QJsonObject &data)
@@ -228,10 +430,25 @@ bool ChannelBooks::handleDataFromBitFlyer(const QJsonObject &data)
         // we assume a snapshot if we got more than 40 asks/bids
         bool gotSnapshot = (cntBid > 40) || (cntAsk > 40);
         if (gotSnapshot) {
-            // we clear the current book:
-            _bids.clear();
-            _asks.clear();
+            // we replace the current book:
+            _bids.beginBulk();
+            for (const auto &b : data["bids"].toArray()) {
+                const auto &o = b.toObject();
+                double size = o["size"].toDouble();
+                if (size > 0.0)
+                    _bids.appendBulk(BookItem(toTicks(o["price"].toDouble()), 1, size));
+            }
+            _bids.endBulk();
+            _asks.beginBulk();
+            for (const auto &a : data["asks"].toArray()) {
+                const auto &o = a.toObject();
+                double size = o["size"].toDouble();
+                if (size > 0.0)
+                    _asks.appendBulk(BookItem(toTicks(o["price"].toDouble()), 1, -size));
+            }
+            _asks.endBulk();
             _bitFlyerGotSnapshot = true;
+            snapshotReceived();
             didUpdate = true;
         }
 
@@ -245,7 +462,7 @@ bool ChannelBooks::handleDataFromBitFlyer(const QJsonObject &data)
             if (cntBid>0||cntAsk>0)
                 qCDebug(Cchannel) << __PRETTY_FUNCTION__ << maxCntAsk << maxCntBid << data; // todo how to handle data after timeout? (we should remove old ones?)
         }
-        if (data.contains("asks") && _bitFlyerGotSnapshot) {
+        if (data.contains("asks") && _bitFlyerGotSnapshot && !gotSnapshot) {
             // process asks
             const QJsonValue &asks = data["asks"];
             if (asks.isArray()) {
@@ -254,7 +471,7 @@ bool ChannelBooks::handleDataFromBitFlyer(const QJsonObject &data)
                     // expect price and size
                     if (a.isObject()) {
                         const auto &o = a.toObject();
-                        double price = o["price"].toDouble();
+                        qint64 price = toTicks(o["price"].toDouble());
                         double size = o["size"].toDouble();
                         if (size>=0.0)
                             handleSingleEntry(price, size==0.0 ? 0 : -1, -size); // see below on why size==0.0 needs to be handled sep.
@@ -268,7 +485,7 @@ bool ChannelBooks::handleDataFromBitFlyer(const QJsonObject &data)
                 qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "can't handle asks:" << asks << data;
             }
         }
-        if (data.contains("bids") && _bitFlyerGotSnapshot) {
+        if (data.contains("bids") && _bitFlyerGotSnapshot && !gotSnapshot) {
             // process bids
             const QJsonValue &bids = data["bids"];
             if (bids.isArray()) {
@@ -277,7 +494,7 @@ bool ChannelBooks::handleDataFromBitFlyer(const QJsonObject &data)
                     // expect price and size
                     if (a.isObject()) {
                         const auto &o = a.toObject();
-                        double price = o["price"].toDouble();
+                        qint64 price = toTicks(o["price"].toDouble());
                         double size = o["size"].toDouble();
                         // bitFlyer sends size 0 if the price is empty not if a single price bid was cancelled
                         // but as handleSingleEntry does amount=0 -> ask we need to treat this differently here!
@@ -298,133 +515,273 @@ bool ChannelBooks::handleDataFromBitFlyer(const QJsonObject &data)
         if (data.contains("tick_id")) {
             if (false and _symbol == "BCH_BTC")
                 qCDebug(Cchannel) << __PRETTY_FUNCTION__ << data;
-            // use best_bid / best_bid_size
-            double price = data["best_bid"].toDouble();
-            double amount = data["best_bid_size"].toDouble();
-
-            if (_bids.size() == 1 )
-                _bids.clear();
-
-            // check whether best_bid is greater than bids?
-            while (_bids.begin() != _bids.end() && ( price < _bids.begin()->first)) {
-                // this is no bug. see below qCDebug(Cchannel) << __PRETTY_FUNCTION__ << _symbol << "ticker needs to delete bids!" << price << _bids.begin()->first;
-                _bids.erase(_bids.begin());
-            }
-
-            if ((_bids.cbegin() != _bids.cend()) &&
-                    (price == _bids.cbegin()->first)) {
-                _bids.begin()->second._amount = amount;
-            } else
-                _bids.insert(std::make_pair(price, BookItem(price, 1, amount)));
-            // and best_ask / best_ask_size
-            price = data["best_ask"].toDouble();
-            amount = data["best_ask_size"].toDouble();
-
-            if (_asks.size()==1) // we simply replace in this case
-                _asks.clear();
-
-            // check whether best_ask is smaller than asks?
-            while (_asks.begin() != _asks.end() && ( price > _asks.begin()->first)) {
-                // this is no bug. ticker can come faster than the channel update qCDebug(Cchannel) << __PRETTY_FUNCTION__ << _symbol  << "ticker needs to delete asks!" << price << _asks.begin()->first;
-                _asks.erase(_asks.begin());
-            }
-
-            if ((_asks.cbegin() != _asks.cend()) &&
-                    (price == _asks.cbegin()->first)) {
-                _asks.begin()->second._amount = -amount;
-            } else
-                _asks.insert(std::make_pair(price, BookItem(price, 1, -amount)));
+            // use best_bid / best_bid_size and best_ask / best_ask_size
+            applyBitFlyerTicker(toTicks(data["best_bid"].toDouble()), data["best_bid_size"].toDouble(),
+                                toTicks(data["best_ask"].toDouble()), data["best_ask_size"].toDouble());
             didUpdate = true;
         }
 
         if (didUpdate) {
             if (false && _symbol == "FX_BTC_JPY") printAsksBids();
-            emit dataUpdated();
+            checkCrossed();
+            trimToMaxDepth();
+            updateTopOfBook();
+            notifyDataUpdated();
         }
         return true;
     } else return false;
 }
 
+bool ChannelBooks::handleBitFlyerTicker(const double &bestBid, const double &bestBidSize,
+                                        const double &bestAsk, const double &bestAskSize)
+{
+    markAlive();
+    applyBitFlyerTicker(toTicks(bestBid), bestBidSize, toTicks(bestAsk), bestAskSize);
+    checkCrossed();
+    trimToMaxDepth();
+    updateTopOfBook();
+    notifyDataUpdated();
+    return true;
+}
+
+void ChannelBooks::applyBitFlyerTicker(qint64 bestBid, const double &bestBidSize, qint64 bestAsk, const double &bestAskSize)
+{
+    if (_bids.size() == 1 )
+        _bids.clear();
+
+    // check whether best_bid is greater than bids?
+    while (!_bids.empty() && ( bestBid < _bids.best()._price)) {
+        // this is no bug. see below qCDebug(Cchannel) << __PRETTY_FUNCTION__ << _symbol << "ticker needs to delete bids!" << bestBid << _bids.best()._price;
+        _bids.eraseBest();
+    }
+
+    if (!_bids.empty() &&
+            (bestBid == _bids.best()._price)) {
+        _bids.modify(&_bids.best())._amount = bestBidSize;
+    } else
+        _bids.insert(BookItem(bestBid, 1, bestBidSize));
+
+    if (_asks.size()==1) // we simply replace in this case
+        _asks.clear();
+
+    // check whether best_ask is smaller than asks?
+    while (!_asks.empty() && ( bestAsk > _asks.best()._price)) {
+        // this is no bug. ticker can come faster than the channel update qCDebug(Cchannel) << __PRETTY_FUNCTION__ << _symbol  << "ticker needs to delete asks!" << bestAsk << _asks.best()._price;
+        _asks.eraseBest();
+    }
+
+    if (!_asks.empty() &&
+            (bestAsk == _asks.best()._price)) {
+        _asks.modify(&_asks.best())._amount = -bestAskSize;
+    } else
+        _asks.insert(BookItem(bestAsk, 1, -bestAskSize));
+}
+
 bool ChannelBooks::handleDataFromBinance(const QJsonObject &data, bool complete)
 { // {\"lastUpdateId\":36872610,\"bids\":[[\"0.00107080\",\"0.01000000\",[]],[\"0.00106950\",\"131.00000000\",[]],[\"0.00106940\",\"20.00000000\",[]],[\"0.00106920\",\"18.89000000\",[]],[\"0.00106900\",\"1292.43000000\",[]],[\"0.00106890\",\"2.74000000\",[]],[\"0.00106880\",\"238.07000000\",[]],[\"0.00106850\",\"73.41000000\",[]],[\"0.00106840\",\"24.92000000\",[]],[\"0.00106830\",\"181.57000000\",[]],[\"0.00106820\",\"23.34000000\",[]],[\"0.00106810\",\"118.57000000\",[]],[\"0.00106800\",\"144.15000000\",[]],[\"0.00106790\",\"1.00000000\",[]],[\"0.00106770\",\"147.49000000\",[]],[\"0.00106760\",\"2.00000000\",[]],[\"0.00106750\",\"15.70000000\",[]],[\"0.00106740\",\"103.11000000\",[]],[\"0.00106730\",\"145.65000000\",[]],[\"0.00106720\",\"23.45000000\",[]]],\"asks\":[[\"0.00107090\",\"909.71000000\",[]],[\"0.00107150\",\"10.56000000\",[]],[\"0.00107160\",\"8.56000000\",[]],[\"0.00107190\",\"195.84000000\",[]],[\"0.00107200\",\"27.37000000\",[]],[\"0.00107210\",\"164.16000000\",[]],[\"0.00107220\",\"53.49000000\",[]],[\"0.00107240\",\"187.91000000\",[]],[\"0.00107250\",\"29.48000000\",[]],[\"0.00107270\",\"82.04000000\",[]],[\"0.00107310\",\"39.50000000\",[]],[\"0.00107370\",\"20.00000000\",[]],[\"0.00107390\",\"9.02000000\",[]],[\"0.00107400\",\"22.68000000\",[]],[\"0.00107410\",\"3.89000000\",[]],[\"0.00107420\",\"5.68000000\",[]],[\"0.00107440\",\"2.53000000\",[]],[\"0.00107450\",\"5.40000000\",[]],[\"0.00107460\",\"6.47000000\",[]],[\"0.00107470\",\"221.99000000\",[]]]}
     if (Channel::handleDataFromBinance(data, complete)) {
         // qCDebug(Cchannel) << __PRETTY_FUNCTION__ << _symbol << "lastUpdateId=" << (int64_t)data["lastUpdateId"].toDouble() << data["bids"].toArray().size() << data["asks"].toArray().size();
         if (complete) {
-            _bids.clear();
+            _bids.beginBulk();
             for (const auto &b : data["bids"].toArray()) {
                 if (b.isArray()) {
                     const QJsonArray &ba = b.toArray();
-                    double price = ba[0].toString().toDouble();
-                    double quantity = ba[1].toString().toDouble();
-                    _bids.insert(std::make_pair(price, BookItem(price, 1, quantity)));
+                    qint64 price = toTicks(ba[0]);
+                    double quantity = Decimal::toDouble(ba[1]);
+                    if (quantity > 0.0)
+                        _bids.appendBulk(BookItem(price, 1, quantity));
                 } else qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "expect array" << b;
             }
+            _bids.endBulk();
 
-            _asks.clear();
+            _asks.beginBulk();
             for (const auto &a : data["asks"].toArray()) {
                 if (a.isArray()) {
                     const QJsonArray &ba = a.toArray();
-                    double price = ba[0].toString().toDouble();
-                    double quantity = ba[1].toString().toDouble();
-                    _asks.insert(std::make_pair(price, BookItem(price, 1, -quantity)));
+                    qint64 price = toTicks(ba[0]);
+                    double quantity = Decimal::toDouble(ba[1]);
+                    if (quantity > 0.0)
+                        _asks.appendBulk(BookItem(price, 1, -quantity));
                 } else qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "expect array" << a;
             }
+            _asks.endBulk();
+            snapshotReceived();
+            _binanceLastUpdateId = (qint64)data["lastUpdateId"].toDouble();
+            // now apply the diffs we got meanwhile (a gap buffers into _binanceDiffs again):
+            std::swap(_binanceDiffs, _binanceReplay);
+            for (std::size_t i = 0; i < _binanceReplay.size(); ++i)
+                handleBinanceDiff(_binanceReplay[i]);
+            _binanceReplay.clear();
             //printAsksBids();
-            emit dataUpdated();
         } else {
-            assert(false); // not yet impl would need to check lastUpdateId being consecutive... or reset if not
+            BinanceDiff diff;
+            if (diff.fromJson(data))
+                handleBinanceDiff(diff);
+            else qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "unknown data" << data;
         }
+        checkCrossed();
+        trimToMaxDepth();
+        updateTopOfBook();
+        notifyDataUpdated();
         return true;
     } else return false;
 }
 
+bool BinanceDiff::fromJson(const QJsonObject &data)
+{ // {"e":"depthUpdate","E":123456789,"s":"BNBBTC","U":157,"u":160,"b":[["0.0024","10",[]]],"a":[["0.0026","100",[]]]}
+    clear();
+    if (!data.contains("U") || !data.contains("u")) return false;
+    _firstId = (qint64)data["U"].toDouble();
+    _lastId = (qint64)data["u"].toDouble();
+    Level l;
+    for (const auto &b : data["b"].toArray()) {
+        const QJsonArray &ba = b.toArray();
+        if (!l._price.parse(ba[0].toString())) return false;
+        l._qty = Decimal::toDouble(ba[1]);
+        _bids.push_back(l);
+    }
+    for (const auto &a : data["a"].toArray()) {
+        const QJsonArray &aa = a.toArray();
+        if (!l._price.parse(aa[0].toString())) return false;
+        l._qty = Decimal::toDouble(aa[1]);
+        _asks.push_back(l);
+    }
+    return true;
+}
+
+bool ChannelBooks::handleBinanceUpdate(const BinanceDiff &diff)
+{
+    markAlive();
+    handleBinanceDiff(diff);
+    checkCrossed();
+    trimToMaxDepth();
+    updateTopOfBook();
+    notifyDataUpdated();
+    return true;
+}
+
+void ChannelBooks::handleBinanceDiff(const BinanceDiff &diff)
+{
+    if (!_isDiffStream) {
+        _isDiffStream = true; // never trimmed from now on
+        if (_maxDepth)
+            qCWarning(Cchannel) << __PRETTY_FUNCTION__ << _symbol << "maxDepth" << _maxDepth << "ignored for the diff stream";
+    }
+    if (!_binanceLastUpdateId) {
+        // no snapshot yet. keep it for later:
+        _binanceDiffs.push_back(diff); // overwrites the oldest once full
+        requestSnapshot();
+        return;
+    }
+    if (diff._lastId <= _binanceLastUpdateId)
+        return; // already contained in our book
+    if (diff._firstId > _binanceLastUpdateId + 1) {
+        qCWarning(Cchannel) << __PRETTY_FUNCTION__ << _symbol << "missed updates. resyncing." << _binanceLastUpdateId << diff._firstId;
+        requestSnapshot();
+        _binanceDiffs.push_back(diff);
+        return;
+    }
+    // quantities are absolute. 0 -> delete
+    for (const auto &b : diff._bids)
+        handleSingleEntry(toTicks(b._price), b._qty==0.0 ? 0 : -1, b._qty==0.0 ? 1.0 : b._qty);
+    for (const auto &a : diff._asks)
+        handleSingleEntry(toTicks(a._price), a._qty==0.0 ? 0 : -1, -a._qty);
+    _binanceLastUpdateId = diff._lastId;
+}
+
+bool ChannelBooks::handleHitbtcUpdate(const HitbtcUpdate &update)
+{
+    markAlive();
+    for (const auto &b : update._bids)
+        handleSingleEntry(toTicks(b._price), b._qty==0.0 ? 0 : -1, b._qty==0.0 ? 1.0 : b._qty);
+    for (const auto &a : update._asks)
+        handleSingleEntry(toTicks(a._price), a._qty==0.0 ? 0 : -1, -a._qty);
+    checkCrossed();
+    trimToMaxDepth();
+    updateTopOfBook();
+    notifyDataUpdated();
+    return true;
+}
+
 bool ChannelBooks::handleDataFromHitbtc(const QJsonObject &data, bool complete)
 {
     if (Channel::handleDataFromHitbtc(data, complete)) {
-        if (complete) {
-            _bids.clear();
-            _asks.clear();
-        }
-        // now process the arrays ask and bid. Each elem contains price and size and are absolut (size=0 -> delete)
-        for (const auto &b : data["bid"].toArray()) {
-            if (b.isObject()) {
+        // process the arrays ask and bid. Each elem contains price and size and are absolut (size=0 -> delete)
+        if (complete) { // snapshot: replace both sides in one go
+            snapshotReceived();
+            _bids.beginBulk();
+            for (const auto &b : data["bid"].toArray()) {
                 const QJsonObject &bo = b.toObject();
-                double price = bo["price"].toString().toDouble();  // all positive
-                double size = bo["size"].toString().toDouble();
-                handleSingleEntry(price, size==0.0 ? 0 : -1, size == 0.0 ? 1.0 : size);
-            } else qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "expect object" << b << data << complete;
-        }
-        for (const auto &a : data["ask"].toArray()) {
-            if (a.isObject()) {
-                const QJsonObject &bo = a.toObject();
-                double price = bo["price"].toString().toDouble();  // all positive
-                double size = bo["size"].toString().toDouble();
-                handleSingleEntry(price, size==0.0 ? 0 : -1, -size);
-            } else qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "expect object" << a << data << complete;
+                double size = Decimal::toDouble(bo["size"]);
+                if (size > 0.0)
+                    _bids.appendBulk(BookItem(toTicks(bo["price"]), 1, size));
+            }
+            _bids.endBulk();
+            _asks.beginBulk();
+            for (const auto &a : data["ask"].toArray()) {
+                const QJsonObject &ao = a.toObject();
+                double size = Decimal::toDouble(ao["size"]);
+                if (size > 0.0)
+                    _asks.appendBulk(BookItem(toTicks(ao["price"]), 1, -size));
+            }
+            _asks.endBulk();
+        } else {
+            for (const auto &b : data["bid"].toArray()) {
+                if (b.isObject()) {
+                    const QJsonObject &bo = b.toObject();
+                    qint64 price = toTicks(bo["price"]);  // all positive
+                    double size = Decimal::toDouble(bo["size"]);
+                    handleSingleEntry(price, size==0.0 ? 0 : -1, size == 0.0 ? 1.0 : size);
+                } else qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "expect object" << b << data << complete;
+            }
+            for (const auto &a : data["ask"].toArray()) {
+                if (a.isObject()) {
+                    const QJsonObject &bo = a.toObject();
+                    qint64 price = toTicks(bo["price"]);  // all positive
+                    double size = Decimal::toDouble(bo["size"]);
+                    handleSingleEntry(price, size==0.0 ? 0 : -1, -size);
+                } else qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "expect object" << a << data << complete;
+            }
         }
-        emit dataUpdated();
+        checkCrossed();
+        trimToMaxDepth();
+        updateTopOfBook();
+        notifyDataUpdated();
         return true;
     } else return false;
 }
 
-void ChannelBooks::handleSingleEntry(const double &price, const int &count, const double &amount)
+void ChannelBooks::handleSingleEntry(const qint64 &price, const int &count, const double &amount)
+{
+    handleSingleEntry<TradingPolicy>(price, count, amount);
+}
+
+template <class Policy>
+void ChannelBooks::handleSingleEntry(const qint64 &price, const int &count, const double &amount, const int &period)
 { // count == -1 -> set value abs and don't add rel.
-    bool isFunding = _symbol.startsWith("f"); // todo cache this? to avoid possible mismatch from other exchanges!
     // count = 0 -> delete
     // otherwise add/update
-    bool isBid = (isFunding ? (amount<0) : (amount>0));
-    // qCDebug(Cchannel) << isFunding << isBid << price << count << amount;
+    // qCDebug(Cchannel) << Policy::isBid(amount) << price << count << amount;
+    if (Policy::isBid(amount))
+        handleSingleEntry(_bids, price, count, amount, period);
+    else
+        handleSingleEntry(_asks, price, count, amount, period);
+}
+
+template <class Side>
+void ChannelBooks::handleSingleEntry(Side &side, const qint64 &price, const int &count, const double &amount, const int &period)
+{
     // search price
-    std::map<double, BookItem, bool(*)(const double&, const double&)> &map = isBid ? _bids : _asks;
-    auto it = map.find(price);
+    const BookItem *item = side.find(price);
     if (count==0) {
-        if (it != map.end())
-            map.erase(it);
+        if (item)
+            side.erase(item);
         //else qCWarning(Cchannel) << "couldn't find price to be deleted" << price << count << amount;
     } else {
-        if (it != map.end()) {
+        if (item) {
             // update
-            BookItem &bookItem = it->second;
+            BookItem &bookItem = side.modify(item);
+            bookItem._period = period;
             if (count == -1) {
                 bookItem._count = 1;
                 bookItem._amount = amount;
@@ -433,65 +790,274 @@ void ChannelBooks::handleSingleEntry(const double &price, const int &count, cons
                 bookItem._amount += amount;
             }
             if (bookItem._amount == 0.0)
-                map.erase(it);
+                side.erase(item);
         } else {
             // add
-            if (amount != 0.0) {
-                BookItem bookItem(price, count==-1 ? 1 : count, amount);
-                map.insert(std::make_pair(price,bookItem));
+            if (amount != 0.0)
+                side.insert(BookItem(price, count==-1 ? 1 : count, amount, period));
+        }
+    }
+}
+
+ChannelFundingBooks::ChannelFundingBooks(Exchange *exchange, int id, const QString &symbol) :
+    ChannelBooks(exchange, id, symbol)
+{
+}
+
+bool ChannelFundingBooks::handleChannelData(const QJsonArray &data)
+{
+    return handleBitfinexData<FundingPolicy>(data);
+}
+
+bool ChannelFundingBooks::handleBitfinexUpdate(const BitfinexUpdate &update)
+{
+    return applyBitfinexUpdate<FundingPolicy>(update);
+}
+
+void ChannelFundingBooks::unsubscribed()
+{
+    _bidPeriods.clear();
+    _askPeriods.clear();
+    ChannelBooks::unsubscribed();
+}
+
+void ChannelFundingBooks::setTickSize(const double &tickSize)
+{
+    double oldTicksPerUnit = _ticksPerUnit;
+    ChannelBooks::setTickSize(tickSize);
+    if (oldTicksPerUnit == _ticksPerUnit) return;
+    double factor = _ticksPerUnit / oldTicksPerUnit;
+    for (PeriodLevels *levels : { &_bidPeriods, &_askPeriods }) {
+        PeriodLevels rescaled;
+        for (const auto &l : *levels) {
+            BookItem item = l.second;
+            item._price = std::llround(item._price * factor);
+            rescaled[std::make_pair(item._price, item._period)] = item;
+        }
+        levels->swap(rescaled);
+    }
+}
+
+void ChannelFundingBooks::beginSnapshot()
+{
+    _bidPeriods.clear();
+    _askPeriods.clear();
+}
+
+void ChannelFundingBooks::addSnapshotLevel(const BookItem &item)
+{
+    PeriodLevels &levels = FundingPolicy::isBid(item._amount) ? _bidPeriods : _askPeriods;
+    auto it = levels.find(std::make_pair(item._price, item._period));
+    if (it == levels.end())
+        levels.insert(std::make_pair(std::make_pair(item._price, item._period), item));
+    else {
+        (*it).second._count += item._count;
+        (*it).second._amount += item._amount;
+    }
+}
+
+void ChannelFundingBooks::endSnapshot()
+{
+    // one level per rate with the sum over the periods. The maps are sorted by rate:
+    ChannelBooks::beginSnapshot();
+    for (const PeriodLevels *levels : { &_bidPeriods, &_askPeriods }) {
+        for (auto it = levels->cbegin(); it != levels->cend(); ) {
+            BookItem sum = (*it).second;
+            for (++it; it != levels->cend() && (*it).first.first == sum._price; ++it) {
+                sum._count += (*it).second._count;
+                sum._amount += (*it).second._amount;
+                sum._period = 0; // several periods
             }
+            if (levels == &_bidPeriods) _bids.appendBulk(sum); else _asks.appendBulk(sum);
         }
     }
+    ChannelBooks::endSnapshot();
+}
+
+void ChannelFundingBooks::applyLevel(const BookItem &item)
+{ // same semantics as ChannelBooks::handleSingleEntry but for the (rate, period) level
+    const bool isBid = FundingPolicy::isBid(item._amount);
+    PeriodLevels &levels = isBid ? _bidPeriods : _askPeriods;
+    const auto key = std::make_pair(item._price, item._period);
+    auto it = levels.find(key);
+    if (item._count == 0) {
+        if (it != levels.end())
+            levels.erase(it);
+    } else {
+        if (it != levels.end()) {
+            BookItem &level = (*it).second;
+            if (item._count == -1) {
+                level._count = 1;
+                level._amount = item._amount;
+            } else {
+                level._count += item._count;
+                level._amount += item._amount;
+            }
+            if (level._amount == 0.0)
+                levels.erase(it);
+        } else
+            if (item._amount != 0.0)
+                levels.insert(std::make_pair(key, BookItem(item._price, item._count == -1 ? 1 : item._count, item._amount, item._period)));
+    }
+    if (isBid)
+        sumRate(_bids, levels, item._price);
+    else
+        sumRate(_asks, levels, item._price);
+}
+
+template <class Side>
+void ChannelFundingBooks::sumRate(Side &side, const PeriodLevels &levels, const qint64 &rate)
+{
+    auto it = levels.lower_bound(std::make_pair(rate, std::numeric_limits<int>::min()));
+    const BookItem *level = side.find(rate);
+    if (it == levels.end() || (*it).first.first != rate) {
+        if (level) side.erase(level); // no period left at this rate
+        return;
+    }
+    BookItem sum = (*it).second;
+    for (++it; it != levels.end() && (*it).first.first == rate; ++it) {
+        sum._count += (*it).second._count;
+        sum._amount += (*it).second._amount;
+        sum._period = 0;
+    }
+    if (level)
+        side.modify(level) = sum;
+    else
+        side.insert(sum);
+}
+
+bool ChannelBooks::getPrices(bool ask, const double &amount, double &avg, double &limit, double *maxAmount, bool *partial) const
+{
+    if (ask)
+        return getPrices(_asks, amount, avg, limit, maxAmount, partial);
+    else
+        return getPrices(_bids, amount, avg, limit, maxAmount, partial);
 }
 
-bool ChannelBooks::getPrices(bool ask, const double &amount, double &avg, double &limit, double *maxAmount) const
+template <class Side>
+bool ChannelBooks::getPrices(const Side &side, const double &amount, double &avg, double &limit, double *maxAmount, bool *partial) const
 {
-    const BookItemMap &map = ask ? _asks : _bids;
-    if (amount <= 0.0) {
+    if (partial) *partial = false;
+    if (amount <= 0.0 || _isCrossed) {
         if (maxAmount) *maxAmount = 0.0;
         return false;
     }
     //printAsksBids();
-    // go through the map until enough amount is available:
-    double volume = 0.0;
-    double retLimit = 0.0;
+    // binary search on the cumulative amounts of the book:
     double gotAmount = 0.0;
-    double needAmount = amount;
-    for (const auto &item : map) {
-        // how much to consume from current one?
-        double amountAvail = item.second._amount;
-        if (ask) amountAvail = -amountAvail;
-        double consume = amountAvail > needAmount ? needAmount : amountAvail;
-        volume += consume * item.second._price;
-        retLimit = item.second._price;
-
-        gotAmount += consume;
-        if (gotAmount >= amount) break;
-    }
-    if (gotAmount >= amount) {
-        avg = volume / gotAmount;
-        limit = retLimit;
-        //qCDebug(Cchannel) << __FUNCTION__ << _exchange->name() << _symbol << QString("%1").arg(ask ? "ask" : "bid") << amount << "=" << avg << limit;
-        if (maxAmount) *maxAmount = gotAmount; // this is not quite right...
+    double volume = 0.0; // in ticks * amount
+    qint64 retLimit = 0;
+    if (side.take(amount, gotAmount, volume, retLimit)) {
+        avg = (volume / gotAmount) / _ticksPerUnit; // back to prices only here
+        limit = toPrice(retLimit);
+        //qCDebug(Cchannel) << __FUNCTION__ << amount << "=" << avg << limit;
+        if (maxAmount) *maxAmount = gotAmount;
+        if (partial) *partial = side.incompleteAt(retLimit); // we walked beyond the levels kept
         return true;
     } else {
-        //qCWarning(Cchannel) << __FUNCTION__ << _exchange->name() << _symbol << QString("%1").arg(ask ? "ask" : "bid") << amount << "not possible!" << "got amount=" << gotAmount;
-        if (0) for (const auto &item : ask ? _asks : _bids) {
-            qCDebug(Cchannel) << item.second._price << item.second._count << item.second._amount;
+        //qCWarning(Cchannel) << __FUNCTION__ << amount << "not possible!" << "got amount=" << gotAmount;
+        if (0) for (const auto &item : side) {
+            qCDebug(Cchannel) << toPrice(item._price) << item._count << item._amount;
         }
         if (maxAmount)
             *maxAmount = gotAmount;
+        if (partial) *partial = side.truncated(); // there might be more than we keep
         return false; // not possible
     }
 }
 
+void ChannelBooks::setTickSize(const double &tickSize)
+{
+    double oldTicksPerUnit = _ticksPerUnit;
+    Channel::setTickSize(tickSize);
+    if (oldTicksPerUnit == _ticksPerUnit) return;
+    // the order is kept as the scaling is monotonic:
+    double factor = _ticksPerUnit / oldTicksPerUnit;
+    auto rescale = [factor](BookItem &item) { item._price = std::llround(item._price * factor); };
+    _bids.transform(rescale);
+    _asks.transform(rescale);
+    updateTopOfBook();
+}
+
+void ChannelBooks::setMaxDepth(std::size_t levels)
+{
+    if (_isDiffStream && levels)
+        qCWarning(Cchannel) << __PRETTY_FUNCTION__ << _symbol << "ignored for the diff stream" << levels;
+    _maxDepth = levels;
+    if (trimToMaxDepth())
+        updateTopOfBook();
+}
+
+bool ChannelBooks::trimToMaxDepth()
+{
+    if (!_maxDepth || _isDiffStream) return false;
+    std::size_t removed = _bids.trim(_maxDepth);
+    removed += _asks.trim(_maxDepth);
+    return removed > 0;
+}
+
+void ChannelBooks::checkCrossed()
+{
+    // crossed or locked book? Then we missed an update. Ask for a new snapshot of this channel only:
+    _isCrossed = !_bids.empty() && !_asks.empty() && _bids.best()._price >= _asks.best()._price;
+    if (_isCrossed) {
+        qCWarning(Cchannel) << __PRETTY_FUNCTION__ << _id << _symbol << "crossed book! bid" << toPrice(_bids.best()._price) << ">= ask" << toPrice(_asks.best()._price);
+        requestSnapshot();
+    }
+}
+
+void ChannelBooks::updateTopOfBook()
+{
+    if (_bids.empty()) {
+        _top._bidPrice = 0.0;
+        _top._bidAmount = 0.0;
+    } else {
+        _top._bidPrice = toPrice(_bids.best()._price);
+        _top._bidAmount = std::fabs(_bids.best()._amount);
+    }
+    if (_asks.empty()) {
+        _top._askPrice = 0.0;
+        _top._askAmount = 0.0;
+    } else {
+        _top._askPrice = toPrice(_asks.best()._price);
+        _top._askAmount = std::fabs(_asks.best()._amount);
+    }
+    if (_bids.empty() || _asks.empty()) {
+        _top._mid = 0.0;
+        _top._spread = 0.0;
+    } else {
+        _top._mid = (_top._bidPrice + _top._askPrice) / 2.0;
+        _top._spread = _top._askPrice - _top._bidPrice;
+    }
+    ++_top._seq;
+
+    // publish the best levels for readers from other threads:
+    _snapshotTmp._seq = _top._seq;
+    _snapshotTmp._nrBids = fillSnapshotLevels(*this, _bids, _snapshotTmp._bids);
+    _snapshotTmp._nrAsks = fillSnapshotLevels(*this, _asks, _snapshotTmp._asks);
+    _snapshot.store(_snapshotTmp);
+}
+
+template <class Side>
+int ChannelBooks::fillSnapshotLevels(const Channel &ch, const Side &side, BookSnapshot::Level *levels)
+{
+    int n = 0;
+    for (const auto &item : side) {
+        if (n >= BookSnapshot::MaxLevels) break;
+        levels[n]._price = ch.toPrice(item._price);
+        levels[n]._amount = std::fabs(item._amount);
+        ++n;
+    }
+    return n;
+}
+
 void ChannelBooks::printAsksBids() const
 {
     QString temp;
     QTextStream asks(&temp);
     int i = 0;
     for (const auto &item : _asks) {
-        asks << " (" << item.second._price << "," << item.second._count << "," << item.second._amount << ")";
+        asks << " (" << toPrice(item._price) << "," << item._count << "," << item._amount << ")";
         ++i;
         if (i>10)break;
     }
@@ -502,7 +1068,7 @@ void ChannelBooks::printAsksBids() const
 
     i = 0;
     for (const auto &item : _bids) {
-        asks << " (" << item.second._price << "," << item.second._count << "," << item.second._amount << ")";
+        asks << " (" << toPrice(item._price) << "," << item._count << "," << item._amount << ")";
         ++i;
         if (i>10) break;
     }
@@ -512,6 +1078,9 @@ void ChannelBooks::printAsksBids() const
 
 ChannelTrades::ChannelTrades(Exchange *exchange, int id, const QString &symbol, const QString &pair)
  : Channel(exchange, id, "trades", symbol, pair)
+ , _trades(1024)
+ , _maxId(0)
+ , _nrDuplicates(0)
 {
     qCDebug(Cchannel) << __PRETTY_FUNCTION__ << _id << _symbol << _pair;
 }
@@ -535,10 +1104,10 @@ bool ChannelTrades::handleChannelData(const QJsonArray &data)
                     int id = a[0].toInt();
                     long long mts = a[1].toDouble();
                     double amount = a[2].toDouble();
-                    double price = a[3].toDouble();
+                    qint64 price = toTicks(a[3].toDouble());
                     handleSingleEntry(id, mts, amount, price);
                     //printTrades();
-                    emit dataUpdated();
+                    notifyDataUpdated();
                 } else qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "expected array. got" << teData;
             } else
                 if (action.compare("tu")==0){} // noop
@@ -551,7 +1120,10 @@ bool ChannelTrades::handleChannelData(const QJsonArray &data)
                 // array -> assume update messages
                 if (actionValue.toArray()[0].isArray()) {
                     qCDebug(Cchannel) << _id << "array of " << actionValue.toArray().count() << "arrays";
-                    for (auto a : actionValue.toArray()) {
+                    // the snapshot is newest first but we keep them in order of arrival:
+                    const QJsonArray &arr = actionValue.toArray();
+                    for (int i = arr.count() - 1; i >= 0; --i) {
+                        const QJsonValue &a = arr[i];
                         // qCDebug(Cchannel) << a;
                         if (a.isArray()) {
                             if (a.toArray().count()==4) {
@@ -559,7 +1131,7 @@ bool ChannelTrades::handleChannelData(const QJsonArray &data)
                                 int id = a.toArray()[0].toInt();
                                 long long mts = a.toArray()[1].toDouble();
                                 double amount = a.toArray()[2].toDouble();
-                                double price = a.toArray()[3].toDouble();
+                                qint64 price = toTicks(a.toArray()[3].toDouble());
                                 handleSingleEntry(id, mts, amount, price);
                                 //qCDebug(Cchannel) << id << mts << amount << price;
                             } else qCWarning(Cchannel) << __PRETTY_FUNCTION__ << "array elem with unknown data" << a;
@@ -574,16 +1146,27 @@ bool ChannelTrades::handleChannelData(const QJsonArray &data)
                     int id = a[0].toInt();
                     long long mts = a[1].toDouble();
                     double amount = a[2].toDouble();
-                    double price = a[3].toDouble();
+                    qint64 price = toTicks(a[3].toDouble());
                     handleSingleEntry(id, mts, amount, price);
                 }
                 //printTrades();
-                emit dataUpdated();
+                notifyDataUpdated();
             }
         return true;
     } else return false;
 }
 
+bool ChannelTrades::handleBitfinexUpdate(const BitfinexUpdate &update)
+{
+    if (!Channel::handleBitfinexUpdate(update)) return false;
+    if (update._kind == BitfinexUpdate::TradeExecuted && update._nrValues == 4) {
+        // ID, MTS, AMOUNT, PRICE
+        const double *v = update._values;
+        handleSingleEntry((int)v[0], (long long)v[1], v[2], toTicks(v[3]));
+        notifyDataUpdated();
+    }
+    return true;
+}
 
 bool ChannelTrades::handleDataFromBitFlyer(const QJsonObject &data)
 {
@@ -591,9 +1174,9 @@ bool ChannelTrades::handleDataFromBitFlyer(const QJsonObject &data)
         // qCDebug(Cchannel) << __PRETTY_FUNCTION__ << data;
 
         int id = data["id"].toInt();
-        // side (SELL/BUY)
-        double price = data["price"].toDouble();
+        qint64 price = toTicks(data["price"].toDouble());
         double amount = data["size"].toDouble(); // always positive
+        if (data["side"].toString() == "SELL") amount = -amount; // side of the taker (SELL/BUY)
         QString exec_date = data["exec_date"].toString();
         // convert exec_date to mts (milliseconds) todo, e.g. 2017-10-31T19:46:14.9227963Z
         QDateTime execdt = QDateTime::fromString(exec_date, Qt::ISODate);
@@ -601,7 +1184,7 @@ bool ChannelTrades::handleDataFromBitFlyer(const QJsonObject &data)
         long long mts = execdt.toMSecsSinceEpoch();
         handleSingleEntry(id, mts, amount, price);
 
-        emit dataUpdated();
+        notifyDataUpdated();
         return true;
     } else return false;
 }
@@ -609,7 +1192,10 @@ bool ChannelTrades::handleDataFromBitFlyer(const QJsonObject &data)
 bool ChannelTrades::handleDataFromBinance(const QJsonObject &data, bool complete)
 {
     if (Channel::handleDataFromBinance(data, complete)) {
-        if (complete) _trades.clear();
+        if (complete) {
+            _trades.clear();
+            _maxId = 0; // the ids of a new set can be lower
+        }
 
         //qCDebug(Cchannel) << __PRETTY_FUNCTION__ << complete << data; // QJsonObject({"E":1518903528448,"M":true,"T":1518903528445,"a":24828428,"b":24828335,"e":"trade","m":true,"p":"0.00107340","q":"18.60000000","s":"BNBBTC","t":9578246})
 
@@ -618,38 +1204,65 @@ bool ChannelTrades::handleDataFromBinance(const QJsonObject &data, bool complete
             return false;
         }
         int id = data["t"].toInt();
-        double price = data["p"].toString().toDouble();
-        double amount = data["q"].toString().toDouble();
+        qint64 price = toTicks(data["p"]);
+        double amount = Decimal::toDouble(data["q"]);
+        if (data["m"].toBool()) amount = -amount; // buyer is the maker -> taker sold
         long long mts = data["E"].toDouble();
         handleSingleEntry(id, mts, amount, price);
-        emit dataUpdated();
+        notifyDataUpdated();
         return true;
     } else return false;
 }
 
-void ChannelTrades::handleSingleEntry(const int &id, const long long &mts, const double &amount, const double &price)
+bool ChannelTrades::handleTrade(const int &id, const long long &mts, const double &amount, const double &price)
+{
+    markAlive();
+    handleSingleEntry(id, mts, amount, toTicks(price));
+    notifyDataUpdated();
+    return true;
+}
+
+void ChannelTrades::handleSingleEntry(const int &id, const long long &mts, const double &amount, const qint64 &price)
 {
-    // search whether id exists already
-    auto it = _trades.find(id);
-    if (it != _trades.end()) {
-        _trades.erase(it);
-    }
     TradesItem item(id, mts, amount, price);
-    _trades.insert(std::make_pair(id, item));
-    // avoid keeping too many
-    while (_trades.size()>1000) {
-        _trades.erase(std::prev(_trades.end())); // todo better use circular_buffer!
+    if (id > _maxId || _trades.empty()) {
+        _maxId = id; // new one. the usual case
+    } else {
+        // might be a repeated one (e.g. snapshot after resubscribe). check the most recent ones only:
+        std::size_t n = _trades.size();
+        for (std::size_t i = 0; i < 64 && i < n; ++i) { // todo const
+            TradesItem &t = _trades[n - 1 - i];
+            if (t._id == id) {
+                t = item;
+                ++_nrDuplicates;
+                return;
+            }
+        }
     }
+    _trades.push_back(item); // overwrites the oldest one if full
+}
+
+void ChannelTrades::setTickSize(const double &tickSize)
+{
+    double oldTicksPerUnit = _ticksPerUnit;
+    Channel::setTickSize(tickSize);
+    if (oldTicksPerUnit == _ticksPerUnit) return;
+    for (std::size_t i = 0; i < _trades.size(); ++i)
+        _trades[i]._price = std::llround(_trades[i]._price * (_ticksPerUnit / oldTicksPerUnit));
+}
+
+QString ChannelTrades::getStatusMsg() const
+{
+    return Channel::getStatusMsg() + QString(" trades %1 (%2 total, %3 dupl.)")
+            .arg(_trades.size()).arg(_trades.seq()).arg(_nrDuplicates);
 }
 
 void ChannelTrades::printTrades() const
 {
     qCDebug(Cchannel) << "trades:" << _trades.size();
-    int i=0;
-    for (const auto &item : _trades) {
-        ++i;
-        if (i>5) { qCDebug(Cchannel) << "..."; break; };
-        const TradesItem &i = item.second;
-        qCDebug(Cchannel) << i._id << i._mts << i._amount << i._price;
+    for (std::size_t n = 0; n < _trades.size(); ++n) {
+        if (n>=5) { qCDebug(Cchannel) << "..."; break; };
+        const TradesItem &i = _trades[_trades.size() - 1 - n];
+        qCDebug(Cchannel) << i._id << i._mts << i._amount << toPrice(i._price);
     }
 }
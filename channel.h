@@ -1,18 +1,67 @@
 #ifndef CHANNEL_H
 #define CHANNEL_H
 #include <memory>
+#include <vector>
+#include <map>
+#include <functional>
+#include <cmath>
 #include <QObject>
 #include <QDateTime>
+#include <QTimer>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QLoggingCategory>
 
+#include "bookside.h"
+#include "seqlock.h"
+#include "ringbuffer.h"
+#include "decimal.h"
+
 class Exchange;
 class ExchangeBitfinex;
+class ChannelFundingBooks;
 class Engine;
 
 Q_DECLARE_LOGGING_CATEGORY(Cchannel)
 
+// single bitfinex channel update decoded without a json DOM (see ExchangeBitfinex::handleChannelDataFast)
+class BitfinexUpdate
+{
+public:
+    enum Kind { Heartbeat = 0, Values, TradeExecuted };
+    Kind _kind;
+    int _nrValues;
+    double _values[4]; // Values: [PRICE, COUNT, AMOUNT] or [RATE, PERIOD, COUNT, AMOUNT], TradeExecuted: [ID, MTS, AMOUNT, PRICE]
+};
+
+// binance depth update of the diff stream (@depth). Kept compact to be reused and buffered
+class BinanceDiff
+{
+public:
+    class Level
+    {
+    public:
+        Decimal _price; // converted to ticks by the channel
+        double _qty; // absolute. 0 -> delete
+    };
+    qint64 _firstId; // U
+    qint64 _lastId; // u
+    std::vector<Level> _bids;
+    std::vector<Level> _asks;
+    void clear() { _firstId = _lastId = 0; _bids.clear(); _asks.clear(); } // keeps the capacity
+    bool fromJson(const QJsonObject &data);
+};
+
+// hitbtc updateOrderbook params. Same levels as the binance diffs (absolute sizes, 0 -> delete)
+class HitbtcUpdate
+{
+public:
+    quint64 _sequence;
+    std::vector<BinanceDiff::Level> _bids;
+    std::vector<BinanceDiff::Level> _asks;
+    void clear() { _sequence = 0; _bids.clear(); _asks.clear(); } // keeps the capacity
+};
+
 class Channel : public QObject
 {
     Q_OBJECT
@@ -23,7 +72,8 @@ public:
     virtual bool handleDataFromBitFlyer(const QJsonObject &data);
     virtual bool handleDataFromBinance(const QJsonObject &data, bool complete); // complete=true -> complete set, false -> partial update
     virtual bool handleDataFromHitbtc(const QJsonObject &data, bool complete); // complete = snapshot
-    virtual QString getStatusMsg() const { return QString("Channel %1 (%2 %3):").arg(_channel).arg(_isSubscribed ? "s" : "u").arg(_isTimeout ? "TO" : "OK"); }
+    virtual bool handleBitfinexUpdate(const BitfinexUpdate &update); // fast path of handleChannelData for single updates
+    virtual QString getStatusMsg() const { return QString("Channel %1 (%2 %3, upd %4/%5 merged):").arg(_channel).arg(_isSubscribed ? "s" : "u").arg(_isTimeout ? "TO" : "OK").arg(_nrMergedNotifies).arg(_nrNotifies); }
 
     virtual void unsubscribed(); // to signal that the channel is currently unsub and won't receive further data
     virtual void subscribed(); // to signal that data will come again
@@ -37,11 +87,32 @@ public:
     int id() const { return _id; }
     void setId(int id) { _id = id; }
     void setTimeoutIntervalMs(unsigned timeoutMs) { _timeoutMs = timeoutMs; }
+    void setMinNotifyIntervalMs(unsigned intervalMs) { _minNotifyIntervalMs = intervalMs; } // 0 = once per event loop turn
+    quint64 nrMergedNotifies() const { return _nrMergedNotifies; }
+
+    // prices are kept as integer number of ticks (e.g. tickSize 0.00000100 from the exchange info)
+    virtual void setTickSize(const double &tickSize);
+    double tickSize() const { return 1.0 / _ticksPerUnit; }
+    qint64 toTicks(const double &price) const { return std::llround(price * _ticksPerUnit); }
+    qint64 toTicks(const Decimal &price) const { return price.toTicks(_ticksPerUnit); } // exact
+    qint64 toTicks(const QJsonValue &price) const; // json number or decimal string
+    double toPrice(const qint64 &ticks) const { return ticks / _ticksPerUnit; }
 signals:
     void dataUpdated();
     void timeout(int id, bool isTimeout);
+    void snapshotNeeded(int id); // the exchange should (re)send a full snapshot for this channel
 public slots:
+protected slots:
+    void emitDataUpdated(); // deferred by notifyDataUpdated()
 protected:
+    void markAlive(); // got data: updates _lastMsg and clears the timeout
+    void notifyDataUpdated(); // coalesced emit of dataUpdated(). multiple calls before it's emitted are merged
+    bool _notifyPending;
+    unsigned _minNotifyIntervalMs;
+    qint64 _lastNotifyMs;
+    quint64 _nrNotifies;
+    quint64 _nrMergedNotifies;
+
     Exchange *_exchange;
     void timerEvent(QTimerEvent *event) override;
     qint64 _timeoutMs;
@@ -54,6 +125,7 @@ protected:
     QString _symbol;
     QString _pair;
     QDateTime _lastMsg;
+    double _ticksPerUnit; // 1/tickSize
 };
 
 class ChannelBooks : public Channel
@@ -65,29 +137,162 @@ public:
     virtual bool handleDataFromBitFlyer(const QJsonObject &data) override;
     virtual bool handleDataFromBinance(const QJsonObject &data, bool complete) override;
     virtual bool handleDataFromHitbtc(const QJsonObject &data, bool complete); // complete = snapshot
+    virtual bool handleBitfinexUpdate(const BitfinexUpdate &update) override;
+    bool handleBinanceUpdate(const BinanceDiff &diff); // fast path of handleDataFromBinance(data, false)
+    bool handleHitbtcUpdate(const HitbtcUpdate &update); // fast path of handleDataFromHitbtc(data, false)
+    bool handleBitFlyerTicker(const double &bestBid, const double &bestBidSize,
+                              const double &bestAsk, const double &bestAskSize); // fast path of handleDataFromBitFlyer for lightning_ticker
 
-    bool getPrices(bool ask, const double &amount, double &avg, double &limit, double *maxAmount=0) const; // determine at which price I could see the amount
+    bool getPrices(bool ask, const double &amount, double &avg, double &limit, double *maxAmount=0,
+                   bool *partial=0) const; // determine at which price I could see the amount. partial: answer might be wrong due to maxDepth. false if crossed
+    bool isCrossed() const { return _isCrossed; } // best bid >= best ask seen. book is invalid until the new snapshot (trading books only)
+    /* max levels kept per side. 0 = unlimited. The far levels are dropped with each update.
+     * They might be missing later on until the next snapshot, so only for feeds that send
+     * snapshots regularly. Ignored for books maintained from the binance @depth diff stream. */
+    void setMaxDepth(std::size_t levels);
+    std::size_t maxDepth() const { return _maxDepth; }
 
     class BookItem
     {
     public:
-        BookItem(const double &p, const int &c, const double &a) :
-            _price(p), _count(c), _amount(a) {};
-        double _price;
+        BookItem() : _price(0), _count(0), _period(0), _amount(0.0) {};
+        BookItem(const qint64 &p, const int &c, const double &a, const int &period=0) :
+            _price(p), _count(c), _period(period), _amount(a) {};
+        qint64 _price; // in ticks. funding books: rate
         int _count;
+        int _period; // funding books: period in days. 0 otherwise
         double _amount;
     };
 
+    class TopOfBook // POD snapshot of the best levels, updated with each book change
+    {
+    public:
+        double _bidPrice; // 0.0 if no bids
+        double _bidAmount;
+        double _askPrice; // 0.0 if no asks
+        double _askAmount; // positive
+        double _mid; // 0.0 if one side is empty
+        double _spread;
+        quint64 _seq; // incremented on each book change
+    };
+    const TopOfBook &topOfBook() const { return _top; }
+
+    class BookSnapshot // copy of the best levels, published with each book change
+    {
+    public:
+        enum { MaxLevels = 10 };
+        class Level
+        {
+        public:
+            double _price;
+            double _amount; // positive for both sides
+        };
+        quint64 _seq; // as TopOfBook::_seq
+        int _nrBids;
+        int _nrAsks;
+        Level _bids[MaxLevels]; // best first
+        Level _asks[MaxLevels]; // best first
+    };
+    // can be called from any thread. Doesn't block the (main thread) writer.
+    void readSnapshot(BookSnapshot &snap) const { _snapshot.load(snap); }
+
     void printAsksBids() const;
     virtual void unsubscribed() override; // to signal that the channel is currently unsub and won't receive further data -> delete book data
+    virtual void setTickSize(const double &tickSize) override; // rescales existing levels
+    void requestSnapshot(); // clears the book and emits snapshotNeeded (once until a snapshot is received)
+    void snapshotRequestFailed(); // we'll ask again with the next update after the backoff
 protected:
-    void handleSingleEntry(const double &p, const int &c, const double &a);
-    typedef std::map<double, BookItem, bool(*)(const double&, const double&)> BookItemMap;
+    // side semantics of the bitfinex entries. Selected at compile time by the book class:
+    class TradingPolicy // [PRICE, COUNT, AMOUNT], amount > 0 -> bid
+    {
+    public:
+        typedef ChannelBooks Book; // gets the parsed levels
+        enum { CanCross = 0 }; // best bid >= best ask -> we missed an update
+        static bool isBid(const double &amount) { return amount > 0.0; }
+        static bool parse(const Channel &ch, const QJsonArray &a, BookItem &item);
+        static bool parse(const Channel &ch, const double *v, int n, BookItem &item);
+    };
+    class FundingPolicy // [RATE, PERIOD, COUNT, AMOUNT], amount < 0 -> bid (demand), > 0 -> ask (offer)
+    {
+    public:
+        typedef ChannelFundingBooks Book;
+        enum { CanCross = 1 }; // demand rate >= offer rate is fine for different periods
+        static bool isBid(const double &amount) { return amount < 0.0; }
+        static bool parse(const Channel &ch, const QJsonArray &a, BookItem &item);
+        static bool parse(const Channel &ch, const double *v, int n, BookItem &item);
+    };
+    template <class Policy>
+    bool handleBitfinexData(const QJsonArray &data);
+    template <class Policy>
+    bool applyBitfinexUpdate(const BitfinexUpdate &update);
+    // sink for the parsed bitfinex levels (Policy::Book). ChannelFundingBooks has its own
+    void applyLevel(const BookItem &item);
+    void beginSnapshot();
+    void addSnapshotLevel(const BookItem &item);
+    void endSnapshot();
+
+    void handleSingleEntry(const qint64 &p, const int &c, const double &a); // trading book semantics
+    template <class Policy>
+    void handleSingleEntry(const qint64 &p, const int &c, const double &a, const int &period=0);
+    template <class Side>
+    static void handleSingleEntry(Side &side, const qint64 &p, const int &c, const double &a, const int &period);
+    template <class Side>
+    bool getPrices(const Side &side, const double &amount, double &avg, double &limit, double *maxAmount, bool *partial) const;
+    typedef BookSide<qint64, BookItem, std::greater<qint64>> BidSide;
+    typedef BookSide<qint64, BookItem, std::less<qint64>> AskSide;
 
-    BookItemMap _bids;
-    BookItemMap _asks;
+    BidSide _bids;
+    AskSide _asks;
+    TopOfBook _top;
+    void updateTopOfBook(); // publishes _top and the snapshot. to be called after each book change
+    bool trimToMaxDepth(); // drops the levels beyond _maxDepth. true if any were removed
+    std::size_t _maxDepth; // 0 = unlimited
+    BookSnapshot _snapshotTmp; // filled by updateTopOfBook()
+    SeqLock<BookSnapshot> _snapshot;
+    template <class Side>
+    static int fillSnapshotLevels(const Channel &ch, const Side &side, BookSnapshot::Level *levels);
 
     bool _bitFlyerGotSnapshot; // got the first snapshot?
+    void applyBitFlyerTicker(qint64 bestBid, const double &bestBidSize, qint64 bestAsk, const double &bestAskSize);
+
+    bool _snapshotRequested; // snapshotNeeded emitted but no snapshot received yet
+    void snapshotReceived();
+    QTimer _snapshotRetryTimer; // backoff after a failed snapshot request
+    int _snapshotRetryMs; // doubled with each failed request
+    bool _isCrossed;
+    void checkCrossed(); // requestSnapshot() if crossed or locked. after the updates of trading books
+
+    // binance diff depth stream (@depth):
+    bool _isDiffStream; // got diffs. Trimmed levels would be lost until the next REST snapshot so we keep all
+    qint64 _binanceLastUpdateId; // 0 -> waiting for the REST snapshot
+    RingBuffer<BinanceDiff> _binanceDiffs; // buffered while waiting for the snapshot. the oldest get dropped
+    RingBuffer<BinanceDiff> _binanceReplay; // temp. the buffered ones during the replay
+    void handleBinanceDiff(const BinanceDiff &diff);
+};
+
+/* bitfinex f* symbols. The levels are per (rate, period). _bids and _asks contain the sum
+ * over all periods per rate (so getPrices() works on rates). Their _period is the period
+ * if there is only one at that rate, 0 otherwise. */
+class ChannelFundingBooks : public ChannelBooks
+{
+public:
+    ChannelFundingBooks(Exchange *exchange, int id, const QString &symbol);
+    virtual bool handleChannelData(const QJsonArray &data) override;
+    virtual bool handleBitfinexUpdate(const BitfinexUpdate &update) override;
+    virtual void unsubscribed() override;
+    virtual void setTickSize(const double &tickSize) override;
+protected:
+    friend class ChannelBooks; // FundingPolicy::Book
+    void applyLevel(const BookItem &item);
+    void beginSnapshot();
+    void addSnapshotLevel(const BookItem &item);
+    void endSnapshot();
+
+    typedef std::map<std::pair<qint64, int>, BookItem> PeriodLevels; // by (rate, period)
+    PeriodLevels _bidPeriods;
+    PeriodLevels _askPeriods;
+    template <class Side>
+    static void sumRate(Side &side, const PeriodLevels &levels, const qint64 &rate); // updates the level of rate in side
 };
 
 class ChannelTrades : public Channel
@@ -98,27 +303,33 @@ public:
     virtual bool handleChannelData(const QJsonArray &data) override;
     virtual bool handleDataFromBitFlyer(const QJsonObject &data) override;
     virtual bool handleDataFromBinance(const QJsonObject &data, bool complete) override; // complete=true -> complete set, false -> partial update
+    virtual bool handleBitfinexUpdate(const BitfinexUpdate &update) override;
+    bool handleTrade(const int &id, const long long &mts, const double &amount, const double &price); // fast path of handleDataFromBinance/BitFlyer. amount < 0 -> taker sold
+    virtual QString getStatusMsg() const override;
 
     class TradesItem
     {
     public:
         TradesItem(const int &id, const long long &mts,
-                   const double &amount, const double &price) :
+                   const double &amount, const qint64 &price) :
             _id(id), _mts(mts), _amount(amount), _price(price) {};
         int _id;
         long long _mts;
-        double _amount;
-        double _price;
+        double _amount; // >0 taker bought, <0 taker sold
+        qint64 _price; // in ticks, use toPrice()
     };
 
     void printTrades() const;
-    typedef std::map<int, TradesItem, std::greater<int>> TradesMap;
-    const TradesMap &trades() const {return _trades;}
+    typedef RingBuffer<TradesItem> Trades; // in order of arrival, newest at back()
+    const Trades &trades() const {return _trades;}
+    virtual void setTickSize(const double &tickSize) override; // rescales existing trades
 protected:
     void handleSingleEntry(const int &id, const long long &mts,
-                           const double &amount, const double &price);
+                           const double &amount, const qint64 &price);
 
-    TradesMap _trades;
+    Trades _trades;
+    int _maxId; // highest trade id seen so far
+    quint64 _nrDuplicates;
 };
 
 #endif // CHANNEL_H
@@ -0,0 +1,163 @@
+#include <cassert>
+#include <algorithm>
+#include <QDebug>
+
+#include "consolidatedbook.h"
+#include "exchange.h"
+
+Q_LOGGING_CATEGORY(CcBook, "cbook")
+
+ConsolidatedBook::ConsolidatedBook(QObject *parent) : QObject(parent)
+  , _dirty(false)
+  , _snap()
+{
+    qCDebug(CcBook) << __PRETTY_FUNCTION__;
+}
+
+ConsolidatedBook::~ConsolidatedBook()
+{
+    qCDebug(CcBook) << __PRETTY_FUNCTION__;
+}
+
+int ConsolidatedBook::addBook(std::shared_ptr<ChannelBooks> book)
+{
+    assert(book);
+    Source s;
+    s._book = book;
+    s._seq = 0;
+    _sources.push_back(s);
+    int source = (int)_sources.size() - 1;
+    connect(&(*book), SIGNAL(dataUpdated()), this, SLOT(onBookUpdated()));
+    qCDebug(CcBook) << __PRETTY_FUNCTION__ << source << sourceName(source) << book->symbol();
+    updateSource(source);
+    return source;
+}
+
+QString ConsolidatedBook::sourceName(int source) const
+{
+    const auto &book = _sources[source]._book;
+    return book->exchange() ? book->exchange()->name() : book->symbol();
+}
+
+void ConsolidatedBook::onBookUpdated()
+{
+    const QObject *s = sender();
+    for (std::size_t i = 0; i < _sources.size(); ++i) {
+        if (&(*_sources[i]._book) == s) {
+            updateSource((int)i);
+            emit dataUpdated();
+            return;
+        }
+    }
+}
+
+void ConsolidatedBook::updateSource(int source)
+{
+    Source &s = _sources[source];
+    s._book->readSnapshot(_snap);
+    if (_snap._seq == s._seq && s._seq) return; // no change
+    s._seq = _snap._seq;
+    copyLevels(s._bids, source, _snap._bids, _snap._nrBids);
+    copyLevels(s._asks, source, _snap._asks, _snap._nrAsks);
+    _dirty = true;
+}
+
+void ConsolidatedBook::copyLevels(Levels &levels, int source, const ChannelBooks::BookSnapshot::Level *newLevels, int nrNew)
+{
+    levels.resize(nrNew); // keeps the capacity
+    for (int i = 0; i < nrNew; ++i) {
+        Level &l = levels[i];
+        l._price = newLevels[i]._price;
+        l._amount = newLevels[i]._amount;
+        l._source = source;
+    }
+}
+
+void ConsolidatedBook::merge() const
+{
+    if (!_dirty) return;
+    mergeSide(_bids, _sources, true);
+    mergeSide(_asks, _sources, false);
+    _dirty = false;
+}
+
+void ConsolidatedBook::mergeSide(Levels &merged, const std::vector<Source> &sources, bool bids)
+{
+    // append the (already sorted) levels of each source and merge them in:
+    merged.clear();
+    for (const auto &s : sources) {
+        const Levels &levels = bids ? s._bids : s._asks;
+        std::size_t mid = merged.size();
+        merged.insert(merged.end(), levels.begin(), levels.end());
+        if (bids)
+            std::inplace_merge(merged.begin(), merged.begin() + mid, merged.end(),
+                               [](const Level &a, const Level &b) { return a._price > b._price; });
+        else
+            std::inplace_merge(merged.begin(), merged.begin() + mid, merged.end(),
+                               [](const Level &a, const Level &b) { return a._price < b._price; });
+    }
+}
+
+bool ConsolidatedBook::bestBid(Level &level) const
+{
+    bool found = false;
+    for (const auto &s : _sources) {
+        if (s._bids.empty()) continue;
+        if (!found || s._bids.front()._price > level._price) {
+            level = s._bids.front();
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool ConsolidatedBook::bestAsk(Level &level) const
+{
+    bool found = false;
+    for (const auto &s : _sources) {
+        if (s._asks.empty()) continue;
+        if (!found || s._asks.front()._price < level._price) {
+            level = s._asks.front();
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool ConsolidatedBook::isCrossedAcrossSources() const
+{
+    // the first level of a source is its best one:
+    for (std::size_t i = 0; i < _sources.size(); ++i) {
+        if (_sources[i]._bids.empty()) continue;
+        const double &bid = _sources[i]._bids.front()._price;
+        for (std::size_t j = 0; j < _sources.size(); ++j) {
+            if (j == i || _sources[j]._asks.empty()) continue;
+            if (_sources[j]._asks.front()._price < bid) return true;
+        }
+    }
+    return false;
+}
+
+bool ConsolidatedBook::getPrices(bool ask, const double &amount, double &avg, double &limit, double *maxAmount) const
+{
+    const Levels &levels = ask ? asks() : bids();
+    if (amount <= 0.0) {
+        if (maxAmount) *maxAmount = 0.0;
+        return false;
+    }
+    double gotAmount = 0.0;
+    double volume = 0.0;
+    for (const auto &l : levels) {
+        double a = std::min(l._amount, amount - gotAmount);
+        gotAmount += a;
+        volume += a * l._price;
+        limit = l._price;
+        if (gotAmount >= amount) {
+            avg = volume / gotAmount;
+            if (maxAmount) *maxAmount = gotAmount;
+            return true;
+        }
+    }
+    if (maxAmount) *maxAmount = gotAmount;
+    return false;
+}
@@ -0,0 +1,76 @@
+#ifndef CONSOLIDATEDBOOK_H
+#define CONSOLIDATEDBOOK_H
+
+#include <memory>
+#include <vector>
+#include <QObject>
+#include <QLoggingCategory>
+
+#include "channel.h"
+
+Q_DECLARE_LOGGING_CATEGORY(CcBook)
+
+/* merged, price ordered view of the best levels of several ChannelBooks
+ * (e.g. the same pair at different exchanges). Each level keeps the index of the
+ * book (source) it's from. An update only copies the levels of the book that changed.
+ * The merged sides are built on the first query after an update.
+ */
+class ConsolidatedBook : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ConsolidatedBook(QObject *parent = 0);
+    ConsolidatedBook(const ConsolidatedBook &) = delete;
+    virtual ~ConsolidatedBook();
+
+    int addBook(std::shared_ptr<ChannelBooks> book); // returns the source index
+    std::size_t nrSources() const { return _sources.size(); }
+    const std::shared_ptr<ChannelBooks> &book(int source) const { return _sources[source]._book; }
+    QString sourceName(int source) const; // exchange name
+
+    class Level
+    {
+    public:
+        double _price;
+        double _amount; // positive for both sides
+        int _source;
+    };
+    typedef std::vector<Level> Levels;
+    const Levels &bids() const { merge(); return _bids; } // best first
+    const Levels &asks() const { merge(); return _asks; } // best first
+
+    bool bestBid(Level &level) const;
+    bool bestAsk(Level &level) const;
+    // is the best bid of one source higher than the best ask of another one?
+    // otherwise there is no cross venue opportunity at all.
+    bool isCrossedAcrossSources() const;
+    // as ChannelBooks::getPrices but across all sources (ignoring fees and transfers)
+    bool getPrices(bool ask, const double &amount, double &avg, double &limit, double *maxAmount=0) const;
+
+signals:
+    void dataUpdated();
+public slots:
+    void onBookUpdated(); // from the ChannelBooks
+
+protected:
+    class Source
+    {
+    public:
+        std::shared_ptr<ChannelBooks> _book;
+        quint64 _seq; // of the last snapshot copied
+        Levels _bids; // best first
+        Levels _asks; // best first
+    };
+    std::vector<Source> _sources;
+    mutable Levels _bids; // merged from _sources
+    mutable Levels _asks;
+    mutable bool _dirty; // a source changed since the last merge
+    ChannelBooks::BookSnapshot _snap; // temp
+
+    void updateSource(int source);
+    static void copyLevels(Levels &levels, int source, const ChannelBooks::BookSnapshot::Level *newLevels, int nrNew);
+    void merge() const;
+    static void mergeSide(Levels &merged, const std::vector<Source> &sources, bool bids);
+};
+
+#endif // CONSOLIDATEDBOOK_H
@@ -19,14 +19,25 @@ HEADERS += tradestrategy.h \
     exchangenam.h \
     strategyarbitrage.h \
     exchangehitbtc.h \
-    roundingdouble.h
+    roundingdouble.h \
+    bookside.h \
+    seqlock.h \
+    consolidatedbook.h \
+    ringbuffer.h \
+    candleseries.h \
+    indicators.h \
+    jsonscanner.h \
+    decimal.h \
+    streamroutes.h
 SOURCES += tradestrategy.cpp \
     strategyexchgdelta.cpp \
     exchangenam.cpp \
     exchangebinance.cpp \
     strategyarbitrage.cpp \
     exchangehitbtc.cpp \
-    roundingdouble.cpp
+    roundingdouble.cpp \
+    consolidatedbook.cpp \
+    indicators.cpp
 
 SOURCES += main.cpp \
     exchangebitfinex.cpp \
@@ -0,0 +1,174 @@
+#ifndef DECIMAL_H
+#define DECIMAL_H
+
+#include <cstring>
+#include <cmath>
+#include <QtGlobal>
+#include <QString>
+#include <QJsonValue>
+
+/* locale-free parsing of the plain decimal numbers the exchanges send as strings
+ * ("0.00107080", "-12.5", "6131") or as json numbers.
+ * Works directly on the characters (QString utf16 or utf8/latin1 bytes) without a
+ * temporary QString. The digits are accumulated into an integer mantissa and a decimal
+ * exponent, so the conversion to ticks can be done exactly in integer arithmetic and the
+ * one to double is correctly rounded (single multiplication/division by an exact power of 10).
+ * Long digit runs of utf16 strings are read 4 digits at a time (SWAR on a 64-bit word).
+ * Anything else (exponents, more than 19 significant digits, garbage) returns false
+ * from parse() and the toDouble() helpers fall back to QString::toDouble() (C locale as well).
+ */
+class Decimal
+{
+public:
+    Decimal() : _mant(0), _exp(0), _neg(false) {}
+    quint64 _mant;
+    int _exp; // value = (_neg ? -1 : 1) * _mant * 10^_exp
+    bool _neg;
+
+    template <class Ch>
+    bool parse(const Ch *p, int len)
+    {
+        const Ch *e = p + len;
+        _mant = 0;
+        _exp = 0;
+        _neg = false;
+        if (p < e && *p == '-') { _neg = true; ++p; }
+        const Ch *digits = p;
+        int nrSig = 0; // significant digits accumulated
+        p = readDigits(p, e, nrSig);
+        const Ch *intEnd = p;
+        if (p < e && *p == '.') {
+            const Ch *frac = ++p;
+            p = readDigits(p, e, nrSig);
+            _exp = -(int)(p - frac);
+            if (p == frac && intEnd == digits) return false; // "." or "-."
+        } else
+            if (p == digits) return false; // no digits
+        return p == e && nrSig <= 19;
+    }
+    bool parse(const QString &s) { return parse(s.utf16(), s.length()); }
+
+    double toDouble() const
+    {
+        static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        quint64 mant = _mant;
+        int exp = _exp;
+        while (mant > (1ull << 53) && exp < 0 && mant % 10 == 0) { mant /= 10; ++exp; } // trailing zeros
+        double v;
+        if (mant <= (1ull << 53) && exp >= -22 && exp <= 22) // exact
+            v = exp < 0 ? (double)mant / pow10[-exp] : (double)mant * pow10[exp];
+        else
+            v = slowToDouble(mant, exp);
+        return _neg ? -v : v;
+    }
+
+    // llround(value * ticksPerUnit) but exact for integer ticksPerUnit (usually 10^n)
+    qint64 toTicks(const double &ticksPerUnit) const
+    {
+        static const quint64 pow10[] = { 1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+                                         100000000ull, 1000000000ull, 10000000000ull, 100000000000ull,
+                                         1000000000000ull, 10000000000000ull, 100000000000000ull,
+                                         1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+                                         1000000000000000000ull };
+        const quint64 maxTicks = (quint64)Q_INT64_C(0x7fffffffffffffff);
+        if (ticksPerUnit >= 1.0 && ticksPerUnit <= 1e18 && ticksPerUnit == std::floor(ticksPerUnit)) {
+            const quint64 tpu = (quint64)ticksPerUnit;
+            int k = 0; // tpu = 10^k?
+            while (k < 18 && pow10[k] < tpu) ++k;
+            quint64 t;
+            bool exact = false;
+            if (pow10[k] == tpu) { // shift the decimal point
+                const int shift = k + _exp;
+                if (shift >= 0) {
+                    if (shift <= 18 && _mant <= maxTicks / pow10[shift]) {
+                        t = _mant * pow10[shift];
+                        exact = true;
+                    }
+                } else
+                    if (shift >= -18) {
+                        const quint64 d = pow10[-shift];
+                        t = _mant / d + ((_mant % d) >= d - d / 2 ? 1 : 0); // half away from zero
+                        exact = true;
+                    }
+            } else
+                if (_exp <= 0 && _exp >= -18 && _mant <= maxTicks / tpu) {
+                    const quint64 d = pow10[-_exp];
+                    const quint64 n = _mant * tpu;
+                    t = n / d + ((n % d) >= d - d / 2 ? 1 : 0);
+                    exact = true;
+                }
+            if (exact && t <= maxTicks)
+                return _neg ? -(qint64)t : (qint64)t;
+        }
+        return std::llround(toDouble() * ticksPerUnit);
+    }
+
+    // the value of a decimal string or json number/string. 0.0 if invalid
+    static double toDouble(const QString &s)
+    {
+        Decimal d;
+        if (d.parse(s)) return d.toDouble();
+        return s.toDouble();
+    }
+    static double toDouble(const QJsonValue &v)
+    {
+        if (v.isString()) return toDouble(v.toString());
+        return v.toDouble();
+    }
+
+private:
+    static bool isDigit(ushort c) { return (unsigned)(c - '0') < 10u; }
+
+    template <class Ch>
+    const Ch *readDigits(const Ch *p, const Ch *e, int &nrSig)
+    {
+        if (sizeof(Ch) == 2) p = readDigits4(p, e, nrSig);
+        for (; p < e && isDigit(*p); ++p) addDigit(*p - '0', nrSig);
+        return p;
+    }
+
+    void addDigit(unsigned d, int &nrSig)
+    {
+        if (_mant || d) {
+            if (++nrSig > 19) return; // parse() fails
+        }
+        _mant = _mant * 10 + d;
+    }
+
+    // 4 utf16 digits per step while at least 4 are left
+    template <class Ch>
+    const Ch *readDigits4(const Ch *p, const Ch *e, int &nrSig)
+    {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        while (p < e && *p == '0' && !_mant) ++p; // leading zeros don't count as significant
+        while (e - p >= 4 && nrSig + 4 <= 19) {
+            quint64 x;
+            std::memcpy(&x, p, 8);
+            // all 4 lanes within '0'..'9'?
+            if ((x & 0xFFF0FFF0FFF0FFF0ull) != 0x0030003000300030ull ||
+                    ((x + 0x0006000600060006ull) & 0x00F000F000F000F0ull) != 0x0030003000300030ull)
+                break;
+            x -= 0x0030003000300030ull; // lanes d0 (first char) .. d3
+            x = (x * 10 + (x >> 16)) & 0x0000FFFF0000FFFFull; // 10*d0+d1, 10*d2+d3
+            const quint64 v = (x & 0xFFFF) * 100 + (x >> 32);
+            if (_mant || v) nrSig += _mant ? 4 : (v >= 1000 ? 4 : v >= 100 ? 3 : v >= 10 ? 2 : 1);
+            _mant = _mant * 10000 + v;
+            p += 4;
+        }
+#else
+        (void)e;
+        (void)nrSig;
+#endif
+        return p;
+    }
+
+    static double slowToDouble(quint64 mant, int exp)
+    {
+        // rare (e.g. > 2^53 significant or tiny values). Format back and use the C locale parser
+        const QString s = QString::number(mant) + QLatin1Char('e') + QString::number(exp);
+        return s.toDouble();
+    }
+};
+
+#endif // DECIMAL_H
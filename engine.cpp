@@ -2,6 +2,8 @@
 #include <cassert>
 #include <iostream>
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
 #include <QSettings>
 #include <QString>
 #include <QTextStream>
@@ -58,6 +60,15 @@ QString mapName( const Exchange *exchange, const QString &pair)
     return QString("%1:%2").arg(exchange ? exchange->name() : QString("null")).arg(pair);
 }
 
+QString candleStoreName( const Exchange *exchange, const QString &pair)
+{
+    // next to the settings (ini format to get a file name on all platforms):
+    const QSettings set(QSettings::IniFormat, QSettings::UserScope, "mcbehr.de", "cryptotrader_engine");
+    const QString dir = QFileInfo(set.fileName()).absolutePath();
+    QDir().mkpath(dir);
+    return QString("%1/candles_%2_%3.json").arg(dir).arg(exchange ? exchange->name() : QString("null")).arg(pair);
+}
+
 Engine::Engine(QObject *parent) : QObject(parent)
 {
     // read telegram token from settings
@@ -208,6 +219,7 @@ Engine::Engine(QObject *parent) : QObject(parent)
         if (1) {
             _providerCandlesMap[mapName(exchange.get(), "BNBBTC")] =
                     std::make_shared<ProviderCandles>(std::dynamic_pointer_cast<ChannelTrades>(exchange->getChannel("BNBBTC", ExchangeBinance::Trades)), this);
+            _providerCandlesMap[mapName(exchange.get(), "BNBBTC")]->setStoreFile(candleStoreName(exchange.get(), "BNBBTC"));
         }
 
         if(1) {
@@ -258,6 +270,7 @@ Engine::Engine(QObject *parent) : QObject(parent)
         if (1) {
             _providerCandlesMap[mapName(exchange.get(), "FX_BTC_JPY")] =
                     std::make_shared<ProviderCandles>(std::dynamic_pointer_cast<ChannelTrades>(exchange->getChannel("FX_BTC_JPY", ExchangeBitFlyer::Trades)), this);
+            _providerCandlesMap[mapName(exchange.get(), "FX_BTC_JPY")]->setStoreFile(candleStoreName(exchange.get(), "FX_BTC_JPY"));
         }
 
         // and we can configure the strategy here as well:
@@ -476,6 +489,7 @@ void Engine::onNewChannelSubscribed(std::shared_ptr<Channel> channel)
     QString mapN = mapName(channel->exchange(), channel->_symbol);
     if (!_providerCandlesMap[mapN] && channel->_channel.compare("trades")==0) {
         _providerCandlesMap[mapN] = std::make_shared<ProviderCandles>(std::dynamic_pointer_cast<ChannelTrades>(channel), this);
+        _providerCandlesMap[mapN]->setStoreFile(candleStoreName(channel->exchange(), channel->_symbol));
 
         if (channel->exchange() && channel->exchange()->name() == bitfinexName) {
             // we can setup the strategies here as well:
@@ -5,6 +5,7 @@
 
 #include "exchangebinance.h"
 #include "channel.h"
+#include "jsonscanner.h"
 /*
  * api description here: https://github.com/binance-exchange/binance-official-api-docs/blob/master/rest-api.md
  *
@@ -75,6 +76,7 @@ bool ExchangeBinance::addPair(const QString &symbol)
         auto chb = std::make_shared<ChannelBooks>(this, ++_nrChannels, symbol);
         chb->setTimeoutIntervalMs(5*60000);
         assert(connect(&(*chb), SIGNAL(timeout(int, bool)), this, SLOT(onChannelTimeout(int,bool))));
+        assert(connect(&(*chb), SIGNAL(snapshotNeeded(int)), this, SLOT(onChannelSnapshotNeeded(int))));
 
         auto ch = std::make_shared<ChannelTrades>(this, ++_nrChannels, symbol, symbol);
         ch->setTimeoutIntervalMs(5*60000);
@@ -93,7 +95,10 @@ std::shared_ptr<Channel> ExchangeBinance::getChannel(const QString &pair, CHANNE
     std::shared_ptr<Channel> toRet;
     auto it = _subscribedChannels.find(pair);
     if (it != _subscribedChannels.cend()) {
-        toRet = type == Book ? (*it).second.first : (*it).second.second;
+        if (type == Book)
+            toRet = (*it).second.first;
+        else
+            toRet = (*it).second.second;
     }
     return toRet;
 }
@@ -553,6 +558,37 @@ void ExchangeBinance::keepAliveListenKey()
     }
 }
 
+void ExchangeBinance::triggerDepthSnapshot(const QString &symbol)
+{
+    QByteArray path("/api/v1/depth"); // weight 10 for limit 1000
+    assert(symbol.length());
+    path.append(QString("?symbol=%1&limit=1000").arg(symbol));
+    if (!triggerApiRequest(path, false, GET, 0,
+                           [this, symbol](QNetworkReply *reply) {
+        auto it = _subscribedChannels.find(symbol);
+        if (it == _subscribedChannels.end()) return;
+        auto &ch = (*it).second.first; // first = channelBooks
+        if (reply->error() != QNetworkReply::NoError) {
+            qCCritical(CeBinance) << __PRETTY_FUNCTION__ << symbol << reply->errorString() << reply->error();
+            ch->snapshotRequestFailed();
+            return;
+        }
+        QByteArray arr = reply->readAll();
+        QJsonDocument d = QJsonDocument::fromJson(arr);
+        if (d.isObject() && d.object().contains("lastUpdateId")) {
+            ch->handleDataFromBinance(d.object(), true);
+        } else {
+            qCWarning(CeBinance) << __PRETTY_FUNCTION__ << "can't handle" << d;
+            ch->snapshotRequestFailed();
+        }
+    })){
+        qCWarning(CeBinance) << __PRETTY_FUNCTION__ << "triggerApiRequest failed!";
+        auto it = _subscribedChannels.find(symbol);
+        if (it != _subscribedChannels.end())
+            (*it).second.first->snapshotRequestFailed();
+    }
+}
+
 void ExchangeBinance::triggerExchangeInfo()
 {
     QByteArray path("/api/v1/exchangeInfo");
@@ -589,6 +625,21 @@ void ExchangeBinance::updateSymbols(const QJsonArray &arr)
         } else
             qCWarning(CeBinance) << __PRETTY_FUNCTION__ << "can't handle " << se;
     }
+    // set the tick size for the price keys of our channels:
+    for (const auto &sc : _subscribedChannels) {
+        const auto &si = _symbolMap.find(sc.first);
+        if (si == _symbolMap.cend()) continue;
+        for (const auto &fi : (*si).second["filters"].toArray()) {
+            const auto &f = fi.toObject();
+            if (f["filterType"].toString() == "PRICE_FILTER") {
+                double tickSize = f["tickSize"].toString().toDouble();
+                if (tickSize > 0.0) {
+                    sc.second.first->setTickSize(tickSize);
+                    sc.second.second->setTickSize(tickSize);
+                }
+            }
+        }
+    }
 }
 
 void ExchangeBinance::printSymbols() const
@@ -638,10 +689,16 @@ void ExchangeBinance::checkConnectWS()
     if (!_isConnected) {
         qCDebug(CeBinance) << __PRETTY_FUNCTION__ << "connecting to ws1";
         QString streams;
+        _streamRoutes.clear();
         for (const auto &symb : _subscribedChannels) {
+            const QString depth = QString("%1@depth").arg(symb.first.toLower()); // for book diff updates. snapshot via REST
+            const QString trade = QString("%1@trade").arg(symb.first.toLower()); // for trade updates
             if (streams.length()) streams.append("/");
-            streams.append(QString("%1@depth20").arg(symb.first.toLower())); // for book updates
-            streams.append(QString("/%1@trade").arg(symb.first.toLower())); // for trade updates
+            streams.append(depth);
+            streams.append("/");
+            streams.append(trade);
+            _streamRoutes.insert(depth, StreamRoute{StreamRoute::Depth, symb.second.first.get(), 0});
+            _streamRoutes.insert(trade, StreamRoute{StreamRoute::Trade, 0, symb.second.second.get()});
         }
         QString url = QString("wss://stream.binance.com:9443/stream?streams=%1").arg(streams);
         _ws.open(QUrl(url));
@@ -755,6 +812,7 @@ void ExchangeBinance::onWs2Error(QAbstractSocket::SocketError err)
 void ExchangeBinance::onWsTextMessageReceived(const QString &msg)
 {
     //qCDebug(CeBinance) << __PRETTY_FUNCTION__ << msg;
+    if (handleStreamDataFast(msg, _streamRoutes, _streamDiff)) return;
     QJsonParseError err;
     QJsonDocument d = QJsonDocument::fromJson(msg.toUtf8(), &err);
     if (d.isNull() || err.error != QJsonParseError::NoError) {
@@ -765,32 +823,105 @@ void ExchangeBinance::onWsTextMessageReceived(const QString &msg)
         const QJsonObject &data = d.object()["data"].toObject();
         // qCDebug(CeBinance) << __PRETTY_FUNCTION__ << stream << data;
         // channel data?
-        if (stream.contains("@depth")) {
-            bool complete = !stream.endsWith("@depth");
-            QString symbol = stream.split('@')[0];
-            // feed channel data. complete=true -> overwrite, complete=false -> partial updates
-            auto it = _subscribedChannels.find(symbol.toUpper());
-            if (it != _subscribedChannels.end()) {
-                auto &ch = (*it).second.first; // first = channelBooks
-                if (ch)
-                    ch->handleDataFromBinance(data, complete);
+        const StreamRoute *route = _streamRoutes.find(stream);
+        if (route) {
+            if (route->_kind == StreamRoute::Depth) {
+                if (route->_books)
+                    route->_books->handleDataFromBinance(data, false); // diffs. complete set via REST
             } else {
-                qCWarning(CeBinance) << __PRETTY_FUNCTION__ << "couldn't find channel for " << symbol << stream;
+                if (route->_trades)
+                    route->_trades->handleDataFromBinance(data, false);
             }
-        } else
-            if (stream.contains("@trade")) {
-                QString symbol = stream.split('@')[0];
-                // feed channel data. complete=true -> overwrite, complete=false -> partial updates
-                auto it = _subscribedChannels.find(symbol.toUpper());
-                if (it != _subscribedChannels.end()) {
-                    auto &ch = (*it).second.second; // second = channel trade
-                    if (ch)
-                        ch->handleDataFromBinance(data, false);
-                } else {
-                    qCWarning(CeBinance) << __PRETTY_FUNCTION__ << "couldn't find channel for " << symbol << stream;
-                }
+        } else {
+            qCWarning(CeBinance) << __PRETTY_FUNCTION__ << "couldn't find channel for " << stream;
+        }
+    }
+}
+
+// reads the levels [["PRICE","QTY",[]],...] after the BeginArray
+static bool readBinanceLevels(JsonScanner &s, std::vector<BinanceDiff::Level> &levels)
+{
+    while (s.next() == JsonScanner::BeginArray) {
+        BinanceDiff::Level l;
+        bool ok = false;
+        if (s.next() != JsonScanner::String || !s.toDecimal(l._price)) return false;
+        if (s.next() != JsonScanner::String) return false;
+        l._qty = s.toDouble(&ok);
+        if (!ok) return false;
+        // ignore further elements (the [] of the old api):
+        while (s.next() != JsonScanner::EndArray)
+            if (!s.skip()) return false;
+        levels.push_back(l);
+    }
+    return s.token() == JsonScanner::EndArray;
+}
+
+bool ExchangeBinance::handleStreamDataFast(const QString &msg, const StreamRoutes<StreamRoute> &routes, BinanceDiff &diff)
+{
+    // {"stream":"bnbbtc@depth","data":{"e":"depthUpdate","E":123456789,"s":"BNBBTC","U":157,"u":160,"b":[["0.0024","10",[]]],"a":[["0.0026","100",[]]]}}
+    // {"stream":"bnbbtc@trade","data":{"e":"trade","E":1518903528448,"s":"BNBBTC","t":9578246,"p":"0.00107340","q":"18.60000000","b":24828335,"a":24828428,"T":1518903528445,"m":true,"M":true}}
+    JsonScanner s(msg);
+    if (s.next() != JsonScanner::BeginObject) return false;
+    if (s.next() != JsonScanner::String || !s.equals("stream")) return false;
+    if (s.next() != JsonScanner::String) return false;
+    const StreamRoute *route = routes.find(msg.utf16() + s.tokenBegin(), s.tokenLength());
+    if (!route) return false; // the DOM path warns
+    const bool isDepth = route->_kind == StreamRoute::Depth;
+    if (s.next() != JsonScanner::String || !s.equals("data")) return false;
+    if (s.next() != JsonScanner::BeginObject) return false;
+
+    diff.clear();
+    int nrIds = 0;
+    qint64 tradeId = -1;
+    long long mts = 0;
+    double price = 0.0;
+    double qty = 0.0;
+    bool buyerIsMaker = false;
+    int nrTradeFields = 0;
+    while (s.next() == JsonScanner::String) { // key
+        if (s.tokenLength() != 1) {
+            s.next();
+            if (!s.skip()) return false;
+            continue;
+        }
+        const ushort key = msg.utf16()[s.tokenBegin()];
+        s.next(); // value
+        bool ok = true;
+        if (isDepth) {
+            switch (key) {
+            case 'e': ok = s.token() == JsonScanner::String && s.equals("depthUpdate"); break;
+            case 'U': ok = s.token() == JsonScanner::Number; diff._firstId = s.toInt64(); ++nrIds; break;
+            case 'u': ok = s.token() == JsonScanner::Number; diff._lastId = s.toInt64(); ++nrIds; break;
+            case 'b': ok = s.token() == JsonScanner::BeginArray && readBinanceLevels(s, diff._bids); break;
+            case 'a': ok = s.token() == JsonScanner::BeginArray && readBinanceLevels(s, diff._asks); break;
+            default: ok = s.skip(); break;
             }
+        } else {
+            switch (key) {
+            case 'e': ok = s.token() == JsonScanner::String && s.equals("trade"); break;
+            case 't': ok = s.token() == JsonScanner::Number; tradeId = s.toInt64(); ++nrTradeFields; break;
+            case 'E': ok = s.token() == JsonScanner::Number; mts = s.toInt64(); ++nrTradeFields; break;
+            case 'p': ok = s.token() == JsonScanner::String; price = s.toDouble(&ok); ++nrTradeFields; break;
+            case 'q': ok = s.token() == JsonScanner::String; qty = s.toDouble(&ok); ++nrTradeFields; break;
+            case 'm': ok = s.token() == JsonScanner::True || s.token() == JsonScanner::False;
+                buyerIsMaker = s.token() == JsonScanner::True; break;
+            default: ok = s.skip(); break;
+            }
+        }
+        if (!ok) return false;
     }
+    if (s.token() != JsonScanner::EndObject || s.next() != JsonScanner::EndObject || s.next() != JsonScanner::End)
+        return false;
+    if (isDepth ? nrIds != 2 : nrTradeFields != 4) return false;
+
+    if (isDepth) {
+        if (route->_books)
+            route->_books->handleBinanceUpdate(diff);
+    } else {
+        if (route->_trades)
+            route->_trades->handleTrade((int)tradeId, mts, buyerIsMaker ? -qty : qty, price); // buyer is the maker -> taker sold
+    }
+    return true;
 }
 
 void ExchangeBinance::onWs2TextMessageReceived(const QString &msg)
@@ -987,6 +1118,18 @@ void ExchangeBinance::onChannelTimeout(int id, bool isTimeout)
     emit channelTimeout(name(), id, isTimeout);
 }
 
+void ExchangeBinance::onChannelSnapshotNeeded(int id)
+{
+    for (const auto &chs : _subscribedChannels) {
+        if (chs.second.first && chs.second.first->id() == id) {
+            qCDebug(CeBinance) << __PRETTY_FUNCTION__ << id << chs.first;
+            triggerDepthSnapshot(chs.first);
+            return;
+        }
+    }
+    qCWarning(CeBinance) << __PRETTY_FUNCTION__ << "unknown channel" << id;
+}
+
 QString ExchangeBinance::getStatusMsg() const
 {
     QString toRet = QString("Exchange %3 (%1 %2):").arg(_isConnected && _isConnectedWs2 ? "CO" : "not connected!")
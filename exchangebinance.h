@@ -5,6 +5,7 @@
 #include <QWebSocket>
 #include <QTimer>
 #include "exchangenam.h"
+#include "streamroutes.h"
 
 static QString binanceName = "binance";
 Q_DECLARE_LOGGING_CATEGORY(CeBinance)
@@ -37,9 +38,21 @@ public:
     typedef enum {Book=0, Trades} CHANNELTYPE;
     std::shared_ptr<Channel> getChannel(const QString &pair, CHANNELTYPE type) const;
     bool addPair(const QString &symbol);
+
+    class StreamRoute
+    {
+    public:
+        enum Kind { Depth = 0, Trade }; // @depth diffs, @trade
+        Kind _kind;
+        ChannelBooks *_books; // for Depth
+        ChannelTrades *_trades; // for Trade
+    };
+    // @depth diffs and @trade without a json DOM into the channel routed to. false -> use the DOM
+    static bool handleStreamDataFast(const QString &msg, const StreamRoutes<StreamRoute> &routes, BinanceDiff &diff);
 signals:
 private Q_SLOTS:
     void onChannelTimeout(int id, bool isTimeout); // from channels
+    void onChannelSnapshotNeeded(int id); // from channel books
     void onQueryTimer(); // from _queryTimer
     void onWsConnected(); // from _ws
     void onWsDisconnected(); // from _ws
@@ -58,7 +71,9 @@ protected:
     virtual bool finishApiRequest(QNetworkRequest &req, QUrl &url, bool doSign, ApiRequestType reqType, const QString &path, QByteArray *postData) override;
 
     QTimer _queryTimer;
-    std::map<QString, std::pair<std::shared_ptr<ChannelBooks>, std::shared_ptr<Channel>>> _subscribedChannels;
+    std::map<QString, std::pair<std::shared_ptr<ChannelBooks>, std::shared_ptr<ChannelTrades>>> _subscribedChannels;
+    StreamRoutes<StreamRoute> _streamRoutes; // by stream name. filled with the streams we connect to
+    BinanceDiff _streamDiff; // reused by handleStreamDataFast
 
     int _nrChannels;
 
@@ -79,6 +94,8 @@ protected:
     QString _listenKey;
     QDateTime _listenKeyCreated;
 
+    void triggerDepthSnapshot(const QString &symbol); // REST book snapshot for the @depth diff stream
+
     void triggerAccountInfo(); // contains balances as well
     QJsonObject _accountInfo;
     std::map<QString, QJsonObject> _symbolMap; // by symbol
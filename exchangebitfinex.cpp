@@ -9,6 +9,7 @@
 #include <QJsonDocument>
 #include <QMessageAuthenticationCode>
 #include "exchangebitfinex.h"
+#include "jsonscanner.h"
 
 Q_LOGGING_CATEGORY(CeBitfinex, "e.bitfinex")
 
@@ -336,6 +337,7 @@ bool ExchangeBitfinex::subscribeChannel(const QString &channel, const QString &s
         }
     }
 
+    _subscribeOptions[QString("%1:%2").arg(channel, symbol)] = options;
     QString innerMsg(QString("\"event\": \"subscribe\", \"channel\": \"%1\", \"symbol\": \"%2\"").arg(channel, symbol));
     for (auto it : options) {
         innerMsg.append(QString(", \"%1\": \"%2\"").arg(it.first, it.second));
@@ -411,6 +413,21 @@ bool ExchangeBitfinex::getSymbolDetails()
     return true;
 }
 
+void ExchangeBitfinex::onChannelSnapshotNeeded(int id)
+{
+    auto it = _subscribedChannels.find(id);
+    if (it == _subscribedChannels.end()) {
+        qCWarning(CeBitfinex) << __PRETTY_FUNCTION__ << "unknown channel" << id;
+        return;
+    }
+    std::shared_ptr<Channel> ch = (*it).second;
+    qCWarning(CeBitfinex) << __PRETTY_FUNCTION__ << "resubscribing" << id << ch->channel() << ch->symbol();
+    // unsubscribe/subscribe only this channel. We get a new snapshot with the subscription.
+    std::map<QString, QString> options = _subscribeOptions[QString("%1:%2").arg(ch->channel(), ch->symbol())];
+    if (!subscribeChannel(ch->channel(), ch->symbol(), options))
+        qCWarning(CeBitfinex) << __PRETTY_FUNCTION__ << "not connected. will be subscribed on reconnect.";
+}
+
 void ExchangeBitfinex::onChannelTimeout(int id, bool isTimeout)
 {
     qCWarning(CeBitfinex) << __PRETTY_FUNCTION__ << id << isTimeout;
@@ -441,22 +458,32 @@ void ExchangeBitfinex::onSslErrors(const QList<QSslError> &errors)
 }
 
 void ExchangeBitfinex::parseJson(const QString &msg)
+{
+    // sometimes we get two/multiple valid json documents concatenated.
+    // walk through the message once and handle each document in place:
+    int from = 0;
+    for (;;) {
+        const int fastEnd = handleChannelDataFast(msg, from);
+        if (fastEnd >= 0) {
+            from = fastEnd;
+            continue;
+        }
+        JsonScanner s(msg, from);
+        int begin, end;
+        const bool complete = s.nextDocument(begin, end);
+        if (begin == end) break; // done
+        parseDocument(msg, begin, end); // reports the errors if !complete
+        if (!complete) break;
+        from = end;
+    }
+}
+
+void ExchangeBitfinex::parseDocument(const QString &msg, int from, int to)
 {
     QJsonParseError err;
-    QByteArray utf8Msg = msg.toUtf8();
-    QJsonDocument json = QJsonDocument::fromJson(utf8Msg, &err);
+    QJsonDocument json = QJsonDocument::fromJson(msg.midRef(from, to - from).toUtf8(), &err);
     if (json.isNull()) {
-        // sometimes we get two/multiple valid json strings concatenated.
-        if (err.error == QJsonParseError::GarbageAtEnd && err.offset>0 && err.offset<utf8Msg.length()) {
-            // call ourself twice:
-            QString msg1 = utf8Msg.left(err.offset);
-            QString msg2 = utf8Msg.right(utf8Msg.length() - err.offset);
-            qCDebug(CeBitfinex) << __PRETTY_FUNCTION__ << "splitting into" << msg1 << "and" << msg2;
-            parseJson(msg1);
-            parseJson(msg2);
-            return;
-        }
-        qCWarning(CeBitfinex) << __PRETTY_FUNCTION__ << "json parse error:" << err.errorString() << err.error << err.offset << msg;
+        qCWarning(CeBitfinex) << __PRETTY_FUNCTION__ << "json parse error:" << err.errorString() << err.error << err.offset << msg.mid(from, to - from);
         return;
     }
     // valid json here:
@@ -680,9 +707,12 @@ void ExchangeBitfinex::handleSubscribedEvent(const QJsonObject &obj)
             assert(_subscribedChannels.find(channelId) == _subscribedChannels.end());
 
             std::shared_ptr<Channel> ptr;
-            if (channel.compare("book")==0)
-                ptr = std::make_shared<ChannelBooks>(this, channelId, symbol);
-            else
+            if (channel.compare("book")==0) {
+                if (symbol.startsWith("f"))
+                    ptr = std::make_shared<ChannelFundingBooks>(this, channelId, symbol);
+                else
+                    ptr = std::make_shared<ChannelBooks>(this, channelId, symbol);
+            } else
                 if (channel.compare("trades")==0)
                     ptr = std::make_shared<ChannelTrades>(this, channelId, symbol, pair);
                 else
@@ -691,6 +721,7 @@ void ExchangeBitfinex::handleSubscribedEvent(const QJsonObject &obj)
             _subscribedChannels.insert(std::make_pair(channelId, ptr));
             emit newChannelSubscribed(ptr);
             connect(&(*ptr), SIGNAL(timeout(int, bool)), this, SLOT(onChannelTimeout(int, bool)));
+            connect(&(*ptr), SIGNAL(snapshotNeeded(int)), this, SLOT(onChannelSnapshotNeeded(int)));
         } else
             if (channelId == 0) { // account info
                 qCDebug(CeBitfinex) << __PRETTY_FUNCTION__ << "account info" << obj;
@@ -713,17 +744,7 @@ void ExchangeBitfinex::handleChannelData(const QJsonArray &data)
             int sequence = channelId ? data.at(dCount-1).toInt() :
                                        data.at(dCount > 3 ? 3 : dCount-1).toInt(); // for auth channel seq id is at 4th pos, except for "hb"
             //qDebug(CeBitfinex) << "sequence=" << sequence << channelId;
-
-                if (_seqLast<0)
-                    _seqLast = sequence;
-                else {
-                    // compare, we expect sequence to be = _seqLast+1
-                    if (++_seqLast != sequence) {
-                        qCWarning(CeBitfinex) << __PRETTY_FUNCTION__ << "sequence mismatch. got" << sequence << "expected" << _seqLast << data;
-                        _seqLast = sequence;
-                        // todo we're out of sequence. now e.g. re-subscribe all books/trades
-                    }
-                }
+            checkSequence(sequence);
 
             auto it = _subscribedChannels.find(channelId);
             if (it != _subscribedChannels.end()) {
@@ -744,3 +765,70 @@ void ExchangeBitfinex::handleChannelData(const QJsonArray &data)
     } else
         qCWarning(CeBitfinex) << __PRETTY_FUNCTION__ << "got empty array!";
 }
+
+void ExchangeBitfinex::checkSequence(int sequence)
+{
+    if (_seqLast<0)
+        _seqLast = sequence;
+    else {
+        // compare, we expect sequence to be = _seqLast+1
+        if (++_seqLast != sequence) {
+            qCWarning(CeBitfinex) << __PRETTY_FUNCTION__ << "sequence mismatch. got" << sequence << "expected" << _seqLast;
+            _seqLast = sequence;
+            // todo we're out of sequence. now e.g. re-subscribe all books/trades
+        }
+    }
+}
+
+int ExchangeBitfinex::decodeChannelUpdate(const QString &msg, int from, int &channelId, BitfinexUpdate &update, int &sequence)
+{
+    // the frequent single updates of book and trades channels:
+    // [CHANID,[PRICE,COUNT,AMOUNT],SEQ] (funding books [RATE,PERIOD,COUNT,AMOUNT])
+    // [CHANID,"te",[ID,MTS,AMOUNT,PRICE],SEQ]
+    // [CHANID,"hb",SEQ]
+    // anything else (events, snapshots, account info, "tu",...) is left to parseDocument
+    JsonScanner s(msg, from);
+    if (s.next() != JsonScanner::BeginArray || s.next() != JsonScanner::Number) return -1;
+    channelId = (int)s.toInt64();
+    if (!channelId) return -1;
+    update._nrValues = 0;
+    switch (s.next()) {
+    case JsonScanner::BeginArray:
+        update._kind = BitfinexUpdate::Values;
+        update._nrValues = s.readNumbers(update._values, 4);
+        if (update._nrValues < 3) return -1; // e.g. a snapshot (array of arrays)
+        break;
+    case JsonScanner::String:
+        if (s.equals("hb"))
+            update._kind = BitfinexUpdate::Heartbeat;
+        else if (s.equals("te")) {
+            update._kind = BitfinexUpdate::TradeExecuted;
+            if (s.next() != JsonScanner::BeginArray) return -1;
+            update._nrValues = s.readNumbers(update._values, 4);
+            if (update._nrValues != 4) return -1;
+        } else return -1;
+        break;
+    default:
+        return -1;
+    }
+    if (s.next() != JsonScanner::Number) return -1;
+    sequence = (int)s.toInt64();
+    if (s.next() != JsonScanner::EndArray) return -1;
+    return s.pos(); // more documents might follow
+}
+
+int ExchangeBitfinex::handleChannelDataFast(const QString &msg, int from)
+{
+    int channelId;
+    BitfinexUpdate update;
+    int sequence;
+    const int end = decodeChannelUpdate(msg, from, channelId, update, sequence);
+    if (end < 0) return -1;
+
+    auto it = _subscribedChannels.find(channelId);
+    if (it == _subscribedChannels.end()) return -1; // parseDocument warns
+    checkSequence(sequence);
+    if ((*it).second->handleBitfinexUpdate(update))
+        emit channelDataUpdated(channelId);
+    return end;
+}
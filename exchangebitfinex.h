@@ -43,6 +43,9 @@ public:
     virtual bool getMinOrderValue(const QString &pair, double &minValue) const override;
     virtual bool getFee(bool buy, const QString &pair, double &feeCur1, double &feeCur2, double amount = 0.0, bool makerFee=false) override;
 
+    // single update at from without a json DOM (see handleChannelDataFast). returns its end or -1
+    static int decodeChannelUpdate(const QString &msg, int from, int &channelId, BitfinexUpdate &update, int &sequence);
+
 signals:
 
 protected:
@@ -55,11 +58,13 @@ private Q_SLOTS:
     void connectWS();
     void onOrderCompleted(int cid, double amount, double price, QString status, QString pair, double fee, QString feeCur);
     void onChannelTimeout(int id, bool isTimeout);
+    void onChannelSnapshotNeeded(int id); // resubscribes the channel
 
 private:
     void disconnectWS();
     bool sendAuth(const QString &apiKey, const QString &skey);
-    void parseJson(const QString &msg);
+    void parseJson(const QString &msg); // one or more concatenated json documents
+    void parseDocument(const QString &msg, int from, int to); // a single one via QJsonDocument
     void handleAuthEvent(const QJsonObject &obj);
     void handleConfEvent(const QJsonObject &obj);
     void handleInfoEvent(const QJsonObject &obj);
@@ -67,6 +72,8 @@ private:
     void handleUnsubscribedEvent(const QJsonObject &obj);
     void handleErrorEvent(const QJsonObject &obj);
     void handleChannelData(const QJsonArray &data);
+    int handleChannelDataFast(const QString &msg, int from); // single update at from without a json DOM. returns its end or -1 -> use parseDocument
+    void checkSequence(int sequence);
     bool getSymbolDetails();
     QJsonArray _symbolDetails;
 
@@ -78,6 +85,7 @@ private:
     QTimer _checkConnectionTimer;
     ChannelAccountInfo _accountInfoChannel;
     std::map<int, std::shared_ptr<Channel>> _subscribedChannels;
+    std::map<QString, std::map<QString, QString>> _subscribeOptions; // by "channel:symbol" for resubscribe
 };
 
 #endif // EXCHANGEBITFINEX_H
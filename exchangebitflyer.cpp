@@ -1,5 +1,6 @@
 
 #include <cassert>
+#include <cmath>
 #include <QDebug>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -8,6 +9,7 @@
 #include <QDateTime>
 #include <QMessageAuthenticationCode>
 #include "exchangebitflyer.h"
+#include "jsonscanner.h"
 
 /* todo
  *
@@ -65,8 +67,11 @@ bool ExchangeBitFlyer::addPair(const QString &pair)
     auto chb = std::make_shared<ChannelBooks>(this, ++_nrChannels,
                                               pair);
     chb->setTimeoutIntervalMs(15000); // 15s timeout for bitflyer
+    chb->setMaxDepth(200); // snapshots are huge and levels get stale (see ticker hack)
     connect(&(*chb), SIGNAL(timeout(int, bool)),
             this, SLOT(onChannelTimeout(int,bool)));
+    connect(&(*chb), SIGNAL(snapshotNeeded(int)),
+            this, SLOT(onChannelSnapshotNeeded(int)));
 
     auto ch = std::make_shared<ChannelTrades>(this, ++_nrChannels,
                                               pair, pair);
@@ -74,6 +79,15 @@ bool ExchangeBitFlyer::addPair(const QString &pair)
     connect(&(*ch), SIGNAL(timeout(int, bool)),
             this, SLOT(onChannelTimeout(int,bool)));
     _subscribedChannels[pair] = std::make_pair(chb, ch);
+    ChannelRoute route;
+    route._kind = ChannelRoute::Executions;
+    route._books = 0;
+    route._trades = &(*ch);
+    _channelRoutes.insert(QString("lightning_executions_%1").arg(pair), route);
+    route._kind = ChannelRoute::Ticker;
+    route._books = &(*chb);
+    route._trades = 0;
+    _channelRoutes.insert(QString("lightning_ticker_%1").arg(pair), route);
 
 
     if (_isConnected) {
@@ -264,6 +278,31 @@ void ExchangeBitFlyer::checkConnectWS()
     }
 }
 
+void ExchangeBitFlyer::onChannelSnapshotNeeded(int id)
+{
+    for (const auto &chan : _subscribedChannels) {
+        const auto &chb = chan.second.first;
+        if (chb && chb->id() == id) {
+            qCWarning(CbitFlyer) << __PRETTY_FUNCTION__ << "resubscribing board snapshot" << chan.first;
+            if (!_isConnected || !sendResubscribeSnapshotMsg(chan.first)) {
+                qCWarning(CbitFlyer) << __PRETTY_FUNCTION__ << "failed to resubscribe" << chan.first;
+                chb->snapshotRequestFailed(); // we get one with the subscribe on reconnect
+            }
+            return;
+        }
+    }
+    qCWarning(CbitFlyer) << __PRETTY_FUNCTION__ << "unknown channel" << id;
+}
+
+bool ExchangeBitFlyer::sendResubscribeSnapshotMsg(const QString &pair)
+{
+    // the snapshot channel sends the current board right after subscribing:
+    QString msg = QString("{\"method\":\"%1\", \"id\":%2, \"params\":{\"channel\":\"lightning_board_snapshot_%3\"} }");
+    if (!_ws.sendTextMessage(msg.arg("unsubscribe").arg(_nextJsonRpcId++).arg(pair))) return false;
+    if (!_ws.sendTextMessage(msg.arg("subscribe").arg(_nextJsonRpcId++).arg(pair))) return false;
+    return true;
+}
+
 bool ExchangeBitFlyer::sendSubscribeMsg(const QString &pair)
 {
     QString msg = QString("{\"method\":\"subscribe\", \"id\":%1, \"params\":{\"channel\":\"%2\"} }");
@@ -358,6 +397,7 @@ void ExchangeBitFlyer::onWsError(QAbstractSocket::SocketError err)
 void ExchangeBitFlyer::onWsTextMessageReceived(const QString &msg)
 {
     //qCDebug(CbitFlyer) << __PRETTY_FUNCTION__ << msg;
+    if (handleChannelMessageFast(msg, _channelRoutes, _executions)) return;
     QJsonParseError err;
     QJsonDocument d = QJsonDocument::fromJson(msg.toUtf8(), &err);
     if (d.isNull() || err.error != QJsonParseError::NoError) {
@@ -770,6 +810,169 @@ void ExchangeBitFlyer::updateOrders(const QString &pair, const QJsonArray &arr)
 
 }
 
+// "2017-11-24T22:13:29.1301581Z" to ms since epoch. The ms are rounded from the first
+// 4 fraction digits as QDateTime::fromString(.., Qt::ISODate) does
+static bool parseExecDate(const ushort *p, int len, long long &mts)
+{
+    // YYYY-MM-DDTHH:MM:SS
+    static const char format[] = "dddd-dd-ddTdd:dd:dd";
+    if (len < 20 || p[len - 1] != 'Z') return false;
+    int v[6] = { 0, 0, 0, 0, 0, 0 };
+    int field = 0;
+    for (int i = 0; i < 19; ++i) {
+        if (format[i] == 'd') {
+            if (p[i] < '0' || p[i] > '9') return false;
+            v[field] = v[field] * 10 + (p[i] - '0');
+        } else {
+            if (p[i] != format[i]) return false;
+            ++field;
+        }
+    }
+    int msec = 0;
+    if (len > 20) {
+        if (p[19] != '.' || len - 21 < 1) return false;
+        int msecInt = 0;
+        int nrDigits = 0;
+        for (int i = 20; i < len - 1; ++i) {
+            if (p[i] < '0' || p[i] > '9') return false;
+            if (nrDigits < 4) {
+                msecInt = msecInt * 10 + (p[i] - '0');
+                ++nrDigits;
+            }
+        }
+        const double secondFraction = msecInt / std::pow(10.0, nrDigits);
+        msec = qMin(qRound(secondFraction * 1000.0), 999);
+    }
+    int y = v[0];
+    const int m = v[1];
+    const int d = v[2];
+    if (m < 1 || m > 12 || d < 1 || d > 31 || v[3] > 23 || v[4] > 59 || v[5] > 59) return false;
+    // days since 1970-01-01 (proleptic gregorian):
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - era * 400;
+    const int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    const long long days = era * 146097LL + doe - 719468;
+    mts = ((days * 24 + v[3]) * 60 + v[4]) * 60000LL + v[5] * 1000LL + msec;
+    return true;
+}
+
+bool ExchangeBitFlyer::handleChannelMessageFast(const QString &msg, const StreamRoutes<ChannelRoute> &routes, std::vector<Execution> &executions)
+{
+    // {"jsonrpc":"2.0","method":"channelMessage","params":{"channel":"lightning_executions_FX_BTC_JPY","message":[{"id":75526868,"side":"BUY","price":940129,"size":0.001,"exec_date":"2017-11-24T22:13:29.1301581Z","buy_child_order_acceptance_id":"JRF20171124-221326-585479","sell_child_order_acceptance_id":"JRF20171125-071316-913089"}]}}
+    // {"jsonrpc":"2.0","method":"channelMessage","params":{"channel":"lightning_ticker_BCH_BTC","message":{"product_code":"BCH_BTC","timestamp":"2018-02-15T21:09:38.565998Z","tick_id":682552,"best_bid":0.135,"best_ask":0.13565,"best_bid_size":0.11,"best_ask_size":0.95429643,"total_bid_depth":577.45185849,"total_ask_depth":483.08264031,"ltp":0.13567,"volume":205.49892664,"volume_by_product":205.49892664}}}
+    // the board channels stay with the DOM (snapshots are rare, updates are handled by ChannelBooks::handleDataFromBitFlyer)
+    JsonScanner s(msg);
+    if (s.next() != JsonScanner::BeginObject) return false;
+    const ChannelRoute *route = 0;
+    bool isChannelMessage = false;
+    bool gotMessage = false;
+    double ticker[4]; // best_bid, best_bid_size, best_ask, best_ask_size
+    int nrTickerFields = 0;
+    bool gotTickId = false;
+    executions.clear();
+    while (s.next() == JsonScanner::String) { // key
+        if (s.equals("method")) {
+            if (s.next() != JsonScanner::String || !s.equals("channelMessage")) return false;
+            isChannelMessage = true;
+        } else if (s.equals("params")) {
+            if (!isChannelMessage || s.next() != JsonScanner::BeginObject) return false; // method comes first
+            while (s.next() == JsonScanner::String) { // key
+                if (s.equals("channel")) {
+                    if (s.next() != JsonScanner::String) return false;
+                    route = routes.find(msg.utf16() + s.tokenBegin(), s.tokenLength());
+                    if (!route) return false; // board or unknown channels
+                } else if (s.equals("message")) {
+                    if (!route) return false; // channel comes first
+                    s.next();
+                    if (route->_kind == ChannelRoute::Executions) {
+                        if (s.token() != JsonScanner::BeginArray) return false;
+                        while (s.next() == JsonScanner::BeginObject) {
+                            Execution e;
+                            int nrFields = 0;
+                            bool sell = false;
+                            while (s.next() == JsonScanner::String) { // key
+                                bool ok = true;
+                                if (s.equals("id")) {
+                                    ok = s.next() == JsonScanner::Number;
+                                    e._id = (int)s.toInt64();
+                                    ++nrFields;
+                                } else if (s.equals("side")) {
+                                    ok = s.next() == JsonScanner::String;
+                                    sell = s.equals("SELL"); // side of the taker (SELL/BUY)
+                                    ++nrFields;
+                                } else if (s.equals("price")) {
+                                    ok = s.next() == JsonScanner::Number;
+                                    if (ok) e._price = s.toDouble(&ok);
+                                    ++nrFields;
+                                } else if (s.equals("size")) {
+                                    ok = s.next() == JsonScanner::Number;
+                                    if (ok) e._amount = s.toDouble(&ok); // always positive
+                                    ++nrFields;
+                                } else if (s.equals("exec_date")) {
+                                    ok = s.next() == JsonScanner::String &&
+                                            parseExecDate(msg.utf16() + s.tokenBegin(), s.tokenLength(), e._mts);
+                                    ++nrFields;
+                                } else {
+                                    s.next();
+                                    ok = s.skip();
+                                }
+                                if (!ok) return false;
+                            }
+                            if (s.token() != JsonScanner::EndObject || nrFields != 5) return false;
+                            if (sell) e._amount = -e._amount;
+                            executions.push_back(e);
+                        }
+                        if (s.token() != JsonScanner::EndArray) return false;
+                    } else {
+                        if (s.token() != JsonScanner::BeginObject) return false;
+                        while (s.next() == JsonScanner::String) { // key
+                            int idx = -1;
+                            if (s.equals("best_bid")) idx = 0;
+                            else if (s.equals("best_bid_size")) idx = 1;
+                            else if (s.equals("best_ask")) idx = 2;
+                            else if (s.equals("best_ask_size")) idx = 3;
+                            else if (s.equals("tick_id")) gotTickId = true;
+                            s.next();
+                            if (idx >= 0) {
+                                bool ok = s.token() == JsonScanner::Number;
+                                if (ok) ticker[idx] = s.toDouble(&ok);
+                                if (!ok) return false;
+                                ++nrTickerFields;
+                            } else if (!s.skip()) return false;
+                        }
+                        if (s.token() != JsonScanner::EndObject) return false;
+                    }
+                    gotMessage = true;
+                } else {
+                    s.next();
+                    if (!s.skip()) return false;
+                }
+            }
+            if (s.token() != JsonScanner::EndObject) return false;
+        } else if (s.equals("id") || s.equals("result")) {
+            return false; // replies use the DOM
+        } else {
+            s.next();
+            if (!s.skip()) return false;
+        }
+    }
+    if (s.token() != JsonScanner::EndObject || s.next() != JsonScanner::End) return false;
+    if (!gotMessage) return false;
+
+    if (route->_kind == ChannelRoute::Executions) {
+        if (route->_trades)
+            for (const auto &e : executions)
+                route->_trades->handleTrade(e._id, e._mts, e._amount, e._price);
+    } else {
+        if (nrTickerFields != 4 || !gotTickId) return false;
+        if (route->_books)
+            route->_books->handleBitFlyerTicker(ticker[0], ticker[1], ticker[2], ticker[3]);
+    }
+    return true;
+}
+
 void ExchangeBitFlyer::processMsg(const QJsonObject &channelMsg)
 {
     //qCWarning(CbitFlyer) << __PRETTY_FUNCTION__ << channelMsg;
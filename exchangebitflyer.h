@@ -10,6 +10,7 @@
 #include <QLoggingCategory>
 #include "exchangenam.h"
 #include "channel.h"
+#include "streamroutes.h"
 
 static QString bitFlyerName = "bitFlyer";
 
@@ -40,11 +41,31 @@ public:
 
     typedef enum {Book=0, Trades} CHANNELTYPE;
     std::shared_ptr<Channel> getChannel(const QString &pair, CHANNELTYPE type) const;
+
+    class ChannelRoute
+    {
+    public:
+        enum Kind { Executions = 0, Ticker }; // lightning_executions_<pair>, lightning_ticker_<pair>
+        Kind _kind;
+        ChannelBooks *_books; // for Ticker
+        ChannelTrades *_trades; // for Executions
+    };
+    class Execution
+    {
+    public:
+        int _id;
+        long long _mts;
+        double _amount; // neg. if the taker sold
+        double _price;
+    };
+    // executions and ticker without a json DOM into the channel routed to. false -> use the DOM
+    static bool handleChannelMessageFast(const QString &msg, const StreamRoutes<ChannelRoute> &routes, std::vector<Execution> &executions);
 signals:
 private Q_SLOTS:
     //void onTimerTimeout(const QString &pair);
     void onQueryTimer();
     void onChannelTimeout(int id, bool isTimeout);
+    void onChannelSnapshotNeeded(int id); // from channel books
     void onWsConnected(); // from _ws
     void onWsDisconnected(); // _ws
     void onWSSslErrors(const QList<QSslError> &errors);
@@ -81,6 +102,7 @@ private:
     void checkConnectWS();
     void disconnectWS();
     bool sendSubscribeMsg(const QString &pair);
+    bool sendResubscribeSnapshotMsg(const QString &pair); // to get a new board snapshot
 
     void triggerGetHealth();
     void triggerAuth();
@@ -90,6 +112,8 @@ private:
     void triggerGetOrders(const QString &pair);
     void triggerGetExecutions();
     void processMsg(const QJsonObject &channelMsg);
+    StreamRoutes<ChannelRoute> _channelRoutes; // by channel name. filled in addPair
+    std::vector<Execution> _executions; // reused by handleChannelMessageFast
     void updateBalances(const QString &type, const QJsonArray &arr);
     void updateOrders(const QString &pair, const QJsonArray &arr);
 
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cassert>
+#include <QTimer>
 #include <QTimerEvent>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -6,6 +8,7 @@
 #include <QNetworkReply>
 #include "exchangehitbtc.h"
 #include "roundingdouble.h"
+#include "jsonscanner.h"
 
 Q_LOGGING_CATEGORY(CeHitbtc, "e.hitbtc")
 
@@ -101,6 +104,7 @@ bool ExchangeHitbtc::internalAddPair(const QString &symbol)
         SymbolData sd (symbol);
         auto chb = std::make_shared<ChannelBooks>(this, ++_nrChannels, symbol);
         assert(connect(&(*chb), SIGNAL(timeout(int, bool)), this, SLOT(onChannelTimeout(int,bool))));
+        assert(connect(&(*chb), SIGNAL(snapshotNeeded(int)), this, SLOT(onChannelSnapshotNeeded(int))));
         sd._book = chb;
         /* todo no trades support yet
         auto ch = std::make_shared<ChannelTrades>(this, ++_nrChannels, symbol, symbol);
@@ -108,6 +112,7 @@ bool ExchangeHitbtc::internalAddPair(const QString &symbol)
         sd._trades = ch; */
         sd._isSubscribed = false;
         _subscribedSymbols.insert(std::make_pair(symbol, sd));
+        _symbolRoutes.insert(symbol, &_subscribedSymbols.at(symbol)); // map nodes don't move
     } else { // got it already?
         qCInfo(CeHitbtc) << __PRETTY_FUNCTION__ << "got subscribed symbol already!" << symbol;
     }
@@ -123,6 +128,13 @@ bool ExchangeHitbtc::internalAddPair(const QString &symbol)
         qCWarning(CeHitbtc) << __PRETTY_FUNCTION__ << "unknown symbol" << symbol;
         return false;
     }
+    // set the tick size for the price keys:
+    double tickSize = _symbolMap[symbol]["tickSize"].toString().toDouble();
+    if (tickSize > 0.0) {
+        const SymbolData &sd = _subscribedSymbols.at(symbol);
+        if (sd._book) sd._book->setTickSize(tickSize);
+        if (sd._trades) sd._trades->setTickSize(tickSize);
+    }
     // print minAmount and fee:
     double amount = -1;
     if (getMinAmount(symbol, amount)) {
@@ -139,7 +151,15 @@ bool ExchangeHitbtc::internalAddPair(const QString &symbol)
         return false;
     }
 
+    if (!subscribeOrderbook(symbol)) {
+        qCWarning(CeHitbtc) << __PRETTY_FUNCTION__ << "failed to addPair" << symbol;
+        return false;
+    }
+    return true;
+}
 
+bool ExchangeHitbtc::subscribeOrderbook(const QString &symbol)
+{
     // subscribe data:
     QJsonObject obj{
         {"method", "subscribeOrderbook"},
@@ -156,9 +176,7 @@ bool ExchangeHitbtc::internalAddPair(const QString &symbol)
                             qCWarning(CeHitbtc) << __PRETTY_FUNCTION__ << "can't find symbol!" << symbol;
                           }
 })){
-        qCWarning(CeHitbtc) << __PRETTY_FUNCTION__ << "failed to addPair" << symbol;
         return false;
-    } else {
     }
     return true;
 }
@@ -601,6 +619,7 @@ void ExchangeHitbtc::onWsPong(quint64 elapsedTime, const QByteArray &payload)
 void ExchangeHitbtc::onWsTextMessageReceived(const QString &msg)
 {
     //qCInfo(CeHitbtc) << __PRETTY_FUNCTION__ << msg;
+    if (handleOrderbookUpdateFast(msg)) return; // the vast majority
     QJsonDocument doc = QJsonDocument::fromJson(msg.toUtf8());
     if (doc.isObject()) {
             const QJsonObject &obj = doc.object();
@@ -773,34 +792,168 @@ void ExchangeHitbtc::handleOrderbookData(const QJsonObject &data, bool isSnapsho
     // symbol known?
     const auto it = _subscribedSymbols.find(symbol);
     if (it != _subscribedSymbols.cend()) {
-        // 1st snapshot needed
         SymbolData &sd = (*it).second;
-        if (sd._needSnapshot && !isSnapshot) {
-            qCDebug(CeHitbtc) << __PRETTY_FUNCTION__ << "got update but need snapshot first!" << symbol;
-            return;
+        bool complete;
+        if (acceptSequence(sd, sequence, isSnapshot, complete))
+            (void)sd._book->handleDataFromHitbtc(data, complete);
+    } else {
+        qCWarning(CeHitbtc) << __PRETTY_FUNCTION__ << "got data for unsubscribed symbol" << symbol;
+    }
+}
+
+bool ExchangeHitbtc::acceptSequence(SymbolData &sd, quint64 sequence, bool isSnapshot, bool &complete)
+{
+    complete = false;
+    // 1st snapshot needed
+    if (sd._needSnapshot && !isSnapshot) {
+        qCDebug(CeHitbtc) << __PRETTY_FUNCTION__ << "got update but need snapshot first!" << sd._symbol;
+        return false;
+    }
+    if (sd._needSnapshot && isSnapshot) {
+        // start sequence here:
+        sd._sequence = sequence;
+        sd._needSnapshot = false;
+        sd._resubscribePending = false;
+        sd._retryDelayMs = 0;
+        complete = true;
+        return true;
+    }
+    // sequence in order?
+    if (sequence != sd._sequence+1) {
+        // retrigger snapshot in case of sequence errors
+        qCWarning(CeHitbtc) << __PRETTY_FUNCTION__ << "out of sequence for" << sd._symbol << sequence << sd._sequence;
+
+        sd._sequence = sequence;
+        // ignore updates until we got a new snapshot:
+        sd._needSnapshot = true;
+        // clear the book. onChannelSnapshotNeeded resubscribes:
+        sd._book->requestSnapshot();
+        return false;
+    }
+    ++sd._sequence;
+    return true; // process data for update
+}
+
+// reads the levels [{"price":"0.054588","size":"0.245"},...] after the BeginArray
+static bool readHitbtcLevels(JsonScanner &s, std::vector<BinanceDiff::Level> &levels)
+{
+    while (s.next() == JsonScanner::BeginObject) {
+        BinanceDiff::Level l;
+        int nrFields = 0;
+        while (s.next() == JsonScanner::String) { // key
+            bool ok = true;
+            if (s.equals("price")) {
+                ok = s.next() == JsonScanner::String && s.toDecimal(l._price);
+                ++nrFields;
+            } else if (s.equals("size")) {
+                ok = s.next() == JsonScanner::String;
+                if (ok) l._qty = s.toDouble(&ok);
+                ++nrFields;
+            } else {
+                s.next();
+                ok = s.skip();
+            }
+            if (!ok) return false;
         }
-        if (sd._needSnapshot && isSnapshot) {
-            // start sequence here:
-            sd._sequence = sequence;
-            sd._needSnapshot = false;
-            (void)sd._book->handleDataFromHitbtc(data, true);
-            return;
+        if (s.token() != JsonScanner::EndObject || nrFields != 2) return false;
+        levels.push_back(l);
+    }
+    return s.token() == JsonScanner::EndArray;
+}
+
+bool ExchangeHitbtc::decodeOrderbookUpdate(const QString &msg, HitbtcUpdate &update, int &symbolBegin, int &symbolLen)
+{
+    // {"jsonrpc":"2.0","method":"updateOrderbook","params":{"ask":[{"price":"0.054590","size":"0.000"}],"bid":[{"price":"0.054558","size":"0.500"}],"symbol":"ETHBTC","sequence":8073830}}
+    JsonScanner s(msg);
+    if (s.next() != JsonScanner::BeginObject) return false;
+    update.clear();
+    bool isUpdate = false;
+    bool gotParams = false;
+    symbolBegin = 0;
+    symbolLen = -1;
+    int nrFields = 0;
+    while (s.next() == JsonScanner::String) { // key
+        if (s.equals("method")) {
+            if (s.next() != JsonScanner::String || !s.equals("updateOrderbook")) return false;
+            isUpdate = true;
+        } else if (s.equals("params")) {
+            if (!isUpdate || s.next() != JsonScanner::BeginObject) return false; // method comes first
+            while (s.next() == JsonScanner::String) { // key
+                bool ok = true;
+                if (s.equals("ask")) {
+                    ok = s.next() == JsonScanner::BeginArray && readHitbtcLevels(s, update._asks);
+                } else if (s.equals("bid")) {
+                    ok = s.next() == JsonScanner::BeginArray && readHitbtcLevels(s, update._bids);
+                } else if (s.equals("symbol")) {
+                    ok = s.next() == JsonScanner::String;
+                    symbolBegin = s.tokenBegin();
+                    symbolLen = s.tokenLength();
+                    ++nrFields;
+                } else if (s.equals("sequence")) {
+                    ok = s.next() == JsonScanner::Number;
+                    update._sequence = (quint64)s.toInt64();
+                    ++nrFields;
+                } else {
+                    s.next();
+                    ok = s.skip();
+                }
+                if (!ok) return false;
+            }
+            if (s.token() != JsonScanner::EndObject) return false;
+            gotParams = true;
+        } else if (s.equals("id")) {
+            return false; // replies use the DOM
+        } else {
+            s.next();
+            if (!s.skip()) return false;
         }
-        // sequence in order?
-        if (sequence != sd._sequence+1) {
-            // retrigger snapshot in case of sequence errors
-            qCWarning(CeHitbtc) << __PRETTY_FUNCTION__ << "out of sequence for" << symbol << sequence << sd._sequence;
+    }
+    if (s.token() != JsonScanner::EndObject || s.next() != JsonScanner::End) return false;
+    return gotParams && nrFields == 2;
+}
 
-            // set needSnapshot and unsubscribe/resubscribe? todo
-            sd._sequence = sequence; // means ignore
-        } else
-            ++sd._sequence;
-        // process data for update
-        (void)sd._book->handleDataFromHitbtc(data, false);
+bool ExchangeHitbtc::handleOrderbookUpdateFast(const QString &msg)
+{
+    int symbolBegin;
+    int symbolLen;
+    if (!decodeOrderbookUpdate(msg, _update, symbolBegin, symbolLen)) return false;
+
+    SymbolData * const *sd = _symbolRoutes.find(msg.utf16() + symbolBegin, symbolLen);
+    if (!sd) return false; // the DOM path warns
+    bool complete;
+    if (acceptSequence(**sd, _update._sequence, false, complete))
+        (void)(*sd)->_book->handleHitbtcUpdate(_update);
+    return true;
+}
 
-    } else {
-        qCWarning(CeHitbtc) << __PRETTY_FUNCTION__ << "got data for unsubscribed symbol" << symbol;
+void ExchangeHitbtc::onChannelSnapshotNeeded(int id)
+{
+    for (auto &s : _subscribedSymbols) {
+        SymbolData &sd = s.second;
+        if (sd._book && sd._book->id() == id) {
+            qCWarning(CeHitbtc) << __PRETTY_FUNCTION__ << "resubscribing" << sd._symbol;
+            if (sd._resubscribePending) return; // pending already
+            sd._needSnapshot = true;
+            if (subscribeOrderbook(sd._symbol)) {
+                sd._resubscribePending = true;
+                return;
+            }
+            // retry with backoff. The book would ask again only with updates we drop:
+            sd._retryDelayMs = sd._retryDelayMs ? std::min(2 * sd._retryDelayMs, 60000) : 1000;
+            qCWarning(CeHitbtc) << __PRETTY_FUNCTION__ << "failed to resubscribe" << sd._symbol << "retry in" << sd._retryDelayMs << "ms";
+            sd._resubscribePending = true; // until the retry. Updates are still dropped as the book is empty
+            sd._book->snapshotRequestFailed();
+            const QString symbol = sd._symbol;
+            QTimer::singleShot(sd._retryDelayMs, this, [this, symbol, id]() {
+                auto it = _subscribedSymbols.find(symbol);
+                if (it == _subscribedSymbols.end()) return;
+                (*it).second._resubscribePending = false;
+                onChannelSnapshotNeeded(id);
+            });
+            return;
+        }
     }
+    qCWarning(CeHitbtc) << __PRETTY_FUNCTION__ << "unknown channel" << id;
 }
 
 void ExchangeHitbtc::onChannelTimeout(int id, bool isTimeout)
@@ -2,6 +2,7 @@
 #define EXCHANGEHITBTC_H
 
 #include "exchangenam.h"
+#include "streamroutes.h"
 #include <QWebSocket>
 #include <QJsonObject>
 
@@ -34,9 +35,13 @@ public:
     typedef enum {Book=0, Trades} CHANNELTYPE;
     std::shared_ptr<Channel> getChannel(const QString &pair, CHANNELTYPE type) const;
 
+    // updateOrderbook without a json DOM (see handleOrderbookUpdateFast). symbol as position in msg
+    static bool decodeOrderbookUpdate(const QString &msg, HitbtcUpdate &update, int &symbolBegin, int &symbolLen);
+
 signals:
 private Q_SLOTS:
     void onChannelTimeout(int id, bool isTimeout); // from channels
+    void onChannelSnapshotNeeded(int id); // from channel books
     void onWsConnected();
     void onWsDisconnected();
     void onWsSslErrors(const QList<QSslError> &errors); // from ws
@@ -44,6 +49,7 @@ private Q_SLOTS:
     void onWsPong(quint64, const QByteArray &);
 protected:
     bool internalAddPair(const QString &symbol);
+    bool subscribeOrderbook(const QString &symbol); // we get a snapshot with each subscribe
     QStringList _pendingAddPairList;
     virtual void timerEvent(QTimerEvent *event) override;
     int _timerId;
@@ -92,15 +98,21 @@ private:
     class SymbolData
     {
     public:
-        SymbolData(const QString &symbol) : _symbol(symbol), _isSubscribed(false), _needSnapshot(true), _sequence(0) {}
+        SymbolData(const QString &symbol) : _symbol(symbol), _isSubscribed(false), _needSnapshot(true), _resubscribePending(false), _retryDelayMs(0), _sequence(0) {}
         QString _symbol;
         bool _isSubscribed; // otherwise subscription pending
-        bool _needSnapshot;
+        bool _needSnapshot; // ignore updates until the snapshot
+        bool _resubscribePending; // subscribeOrderbook sent or retry scheduled
+        int _retryDelayMs; // backoff for failed resubscribes
         quint64 _sequence;
         std::shared_ptr<ChannelBooks> _book;
         std::shared_ptr<Channel> _trades;
     };
     std::map<QString, SymbolData> _subscribedSymbols;
+    StreamRoutes<SymbolData *> _symbolRoutes; // into _subscribedSymbols. by symbol for handleOrderbookUpdateFast
+    bool acceptSequence(SymbolData &sd, quint64 sequence, bool isSnapshot, bool &complete); // false -> ignore the data
+    bool handleOrderbookUpdateFast(const QString &msg); // updateOrderbook without a json DOM. false -> use the DOM
+    HitbtcUpdate _update; // reused by handleOrderbookUpdateFast
     unsigned int _nrChannels;
 
     bool _test1;
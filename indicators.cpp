@@ -0,0 +1,341 @@
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include "indicators.h"
+
+const char *Indicator::typeName(Type type)
+{
+    static const char *names[NrTypes] = { "RSI", "EMA", "MACD", "Bollinger", "ATR", "VWAP" };
+    return names[type];
+}
+
+void Indicator::normalizeParams(Type type, int &period, int &period2, int &period3, double &factor)
+{
+    switch (type) {
+    case RSI:
+    case ATR:
+        if (!period) period = 14;
+        period2 = period3 = 0;
+        factor = 0.0;
+        break;
+    case EMA:
+    case VWAP:
+        if (!period) period = 20;
+        period2 = period3 = 0;
+        factor = 0.0;
+        break;
+    case MACD:
+        if (!period) period = 12;
+        if (!period2) period2 = 26;
+        if (!period3) period3 = 9;
+        factor = 0.0;
+        break;
+    case Bollinger:
+        if (!period) period = 20;
+        period2 = period3 = 0;
+        if (factor == 0.0) factor = 2.0;
+        break;
+    default:
+        assert(false);
+    }
+}
+
+std::unique_ptr<Indicator> Indicator::create(Type type, int period, int period2, int period3, double factor)
+{
+    normalizeParams(type, period, period2, period3, factor);
+    switch (type) {
+    case RSI: return std::unique_ptr<Indicator>(new IndicatorRSI(period));
+    case EMA: return std::unique_ptr<Indicator>(new IndicatorEMA(period));
+    case MACD: return std::unique_ptr<Indicator>(new IndicatorMACD(period, period2, period3));
+    case Bollinger: return std::unique_ptr<Indicator>(new IndicatorBollinger(period, factor));
+    case ATR: return std::unique_ptr<Indicator>(new IndicatorATR(period));
+    case VWAP: return std::unique_ptr<Indicator>(new IndicatorVWAP(period));
+    default:
+        assert(false);
+    }
+    return std::unique_ptr<Indicator>();
+}
+
+IndicatorRSI::IndicatorRSI(int period) :
+    _period(period)
+{
+    assert(_period > 0);
+    reset();
+}
+
+void IndicatorRSI::reset()
+{
+    _nrCloses = 0;
+    _lastClose = 0.0;
+    _avgGain = 0.0;
+    _avgLoss = 0.0;
+}
+
+void IndicatorRSI::add(const IndicatorInput &in)
+{
+    const double &close = in._close;
+    if (_nrCloses > 0) {
+        const double diff = close - _lastClose;
+        const double gain = diff > 0.0 ? diff : 0.0;
+        const double loss = diff < 0.0 ? -diff : 0.0;
+        if (_nrCloses <= _period) {
+            _avgGain += gain;
+            _avgLoss += loss;
+            if (_nrCloses == _period) {
+                _avgGain /= _period;
+                _avgLoss /= _period;
+            }
+        } else {
+            _avgGain = (_avgGain * (_period - 1) + gain) / _period;
+            _avgLoss = (_avgLoss * (_period - 1) + loss) / _period;
+        }
+    }
+    _lastClose = close;
+    if (_nrCloses <= _period) ++_nrCloses;
+}
+
+bool IndicatorRSI::value(const IndicatorInput &in, double *values) const
+{
+    const double &close = in._close;
+    if (_nrCloses < _period) return false; // the forming candle would not complete the first period
+    const double diff = close - _lastClose;
+    const double gain = diff > 0.0 ? diff : 0.0;
+    const double loss = diff < 0.0 ? -diff : 0.0;
+    double avgGain, avgLoss;
+    if (_nrCloses == _period) {
+        avgGain = (_avgGain + gain) / _period;
+        avgLoss = (_avgLoss + loss) / _period;
+    } else {
+        avgGain = (_avgGain * (_period - 1) + gain) / _period;
+        avgLoss = (_avgLoss * (_period - 1) + loss) / _period;
+    }
+    const double sum = avgGain + avgLoss;
+    values[0] = sum > 0.00000001 ? 100.0 * (avgGain / sum) : 0.0; // as TA-Lib
+    return true;
+}
+
+IndicatorEMA::IndicatorEMA(int period) :
+    _period(period), _k(2.0 / (period + 1))
+{
+    assert(_period > 0);
+    reset();
+}
+
+void IndicatorEMA::reset()
+{
+    _nrValues = 0;
+    _ema = 0.0;
+}
+
+void IndicatorEMA::addValue(const double &v)
+{
+    if (_nrValues < _period) {
+        _ema += v;
+        if (++_nrValues == _period)
+            _ema /= _period;
+    } else
+        _ema += _k * (v - _ema);
+}
+
+bool IndicatorEMA::valueFor(const double &v, double &ema) const
+{
+    if (_nrValues + 1 < _period) return false;
+    if (_nrValues + 1 == _period)
+        ema = (_ema + v) / _period;
+    else
+        ema = _ema + _k * (v - _ema);
+    return true;
+}
+
+bool IndicatorEMA::current(double &ema) const
+{
+    if (_nrValues < _period) return false;
+    ema = _ema;
+    return true;
+}
+
+IndicatorMACD::IndicatorMACD(int fast, int slow, int signal) :
+    _fast(fast), _slow(slow), _signal(signal)
+{
+}
+
+void IndicatorMACD::reset()
+{
+    _fast.reset();
+    _slow.reset();
+    _signal.reset();
+}
+
+void IndicatorMACD::add(const IndicatorInput &in)
+{
+    _fast.addValue(in._close);
+    _slow.addValue(in._close);
+    double fast, slow;
+    if (_fast.current(fast) && _slow.current(slow))
+        _signal.addValue(fast - slow);
+}
+
+bool IndicatorMACD::value(const IndicatorInput &in, double *values) const
+{
+    double fast, slow, signal;
+    if (!_fast.valueFor(in._close, fast) || !_slow.valueFor(in._close, slow)) return false;
+    const double macd = fast - slow;
+    if (!_signal.valueFor(macd, signal)) return false;
+    values[0] = macd;
+    values[1] = signal;
+    values[2] = macd - signal;
+    return true;
+}
+
+IndicatorBollinger::IndicatorBollinger(int period, double factor) :
+    _period(period), _factor(factor)
+{
+    assert(_period > 0);
+    reset();
+}
+
+void IndicatorBollinger::reset()
+{
+    _window.clear();
+    _window.reserve(_period - 1);
+    _next = 0;
+    _sum = 0.0;
+    _sumSq = 0.0;
+}
+
+void IndicatorBollinger::add(const IndicatorInput &in)
+{
+    if (_period == 1) return;
+    const double &v = in._close;
+    if (_window.size() < (std::size_t)(_period - 1)) {
+        _window.push_back(v);
+        _sum += v;
+        _sumSq += v * v;
+        return;
+    }
+    const double old = _window[_next];
+    _window[_next] = v;
+    _next = (_next + 1) % _window.size();
+    if (_next) {
+        _sum += v - old;
+        _sumSq += v * v - old * old;
+        return;
+    }
+    // sum up again once per round to bound the accumulated rounding errors (O(1) amortized):
+    _sum = 0.0;
+    _sumSq = 0.0;
+    for (const double &w : _window) {
+        _sum += w;
+        _sumSq += w * w;
+    }
+}
+
+bool IndicatorBollinger::value(const IndicatorInput &in, double *values) const
+{
+    const double &close = in._close;
+    if (_window.size() + 1 < (std::size_t)_period) return false;
+    const double mean = (_sum + close) / _period;
+    const double var = std::max(0.0, (_sumSq + close * close) / _period - mean * mean);
+    const double dev = _factor * std::sqrt(var);
+    values[0] = mean;
+    values[1] = mean + dev;
+    values[2] = mean - dev;
+    return true;
+}
+
+IndicatorATR::IndicatorATR(int period) :
+    _period(period)
+{
+    assert(_period > 0);
+    reset();
+}
+
+void IndicatorATR::reset()
+{
+    _nrCandles = 0;
+    _lastClose = 0.0;
+    _atr = 0.0;
+}
+
+double IndicatorATR::trueRange(const double &high, const double &low) const
+{
+    return std::max(high - low, std::max(std::fabs(high - _lastClose), std::fabs(low - _lastClose)));
+}
+
+void IndicatorATR::add(const IndicatorInput &in)
+{
+    if (_nrCandles > 0) {
+        const double tr = trueRange(in._high, in._low);
+        if (_nrCandles <= _period) {
+            _atr += tr;
+            if (_nrCandles == _period)
+                _atr /= _period;
+        } else
+            _atr = (_atr * (_period - 1) + tr) / _period;
+    }
+    _lastClose = in._close;
+    if (_nrCandles <= _period) ++_nrCandles;
+}
+
+bool IndicatorATR::value(const IndicatorInput &in, double *values) const
+{
+    if (_nrCandles < _period) return false; // the first true range needs a previous close
+    const double tr = trueRange(in._high, in._low);
+    if (_nrCandles == _period)
+        values[0] = (_atr + tr) / _period;
+    else
+        values[0] = (_atr * (_period - 1) + tr) / _period;
+    return true;
+}
+
+IndicatorVWAP::IndicatorVWAP(int period) :
+    _period(period)
+{
+    assert(_period > 0);
+    reset();
+}
+
+void IndicatorVWAP::reset()
+{
+    _window.clear();
+    _window.reserve(_period - 1);
+    _next = 0;
+    _volume = 0.0;
+    _quoteVolume = 0.0;
+}
+
+void IndicatorVWAP::add(const IndicatorInput &in)
+{
+    if (_period == 1) return;
+    const std::pair<double, double> v(in._volume, in._quoteVolume);
+    if (_window.size() < (std::size_t)(_period - 1)) {
+        _window.push_back(v);
+        _volume += v.first;
+        _quoteVolume += v.second;
+        return;
+    }
+    const std::pair<double, double> old = _window[_next];
+    _window[_next] = v;
+    _next = (_next + 1) % _window.size();
+    if (_next) {
+        _volume += v.first - old.first;
+        _quoteVolume += v.second - old.second;
+        return;
+    }
+    // sum up again once per round as for the bollinger bands:
+    _volume = 0.0;
+    _quoteVolume = 0.0;
+    for (const auto &w : _window) {
+        _volume += w.first;
+        _quoteVolume += w.second;
+    }
+}
+
+bool IndicatorVWAP::value(const IndicatorInput &in, double *values) const
+{
+    if (_window.size() + 1 < (std::size_t)_period) return false;
+    const double volume = _volume + in._volume;
+    if (volume <= 0.0) return false;
+    values[0] = (_quoteVolume + in._quoteVolume) / volume;
+    return true;
+}
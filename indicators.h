@@ -0,0 +1,146 @@
+#ifndef INDICATORS_H
+#define INDICATORS_H
+
+#include <vector>
+#include <memory>
+
+// the candle values the indicators use
+class IndicatorInput
+{
+public:
+    double _high;
+    double _low;
+    double _close;
+    double _volume; // 0 if the quote volume is unknown
+    double _quoteVolume; // sum of price*amount of the trades
+};
+
+/* incremental indicators on candles.
+ * add() is called once per closed candle (O(1)). value() evaluates the indicator
+ * with the current (still forming) candle as the newest one without changing
+ * the state, so it can be called on each candle update.
+ * Averages are initialized as TA-Lib does (simple average over the first
+ * period values) so RSI, EMA and ATR match TA_RSI/TA_EMA/TA_ATR over the same candles.
+ */
+class Indicator
+{
+public:
+    enum Type { RSI = 0, EMA, MACD, Bollinger, ATR, VWAP, NrTypes };
+    static const int MaxValues = 3;
+    static const char *typeName(Type type);
+    // replaces params 0 by the defaults (RSI 14, EMA 20, MACD 12 26 9, Bollinger 20 2.0, ATR 14, VWAP 20)
+    // and the unused ones by 0. So equal indicators have equal params.
+    static void normalizeParams(Type type, int &period, int &period2, int &period3, double &factor);
+    static std::unique_ptr<Indicator> create(Type type, int period, int period2, int period3, double factor);
+
+    virtual ~Indicator() {}
+    virtual void reset() = 0;
+    virtual void add(const IndicatorInput &in) = 0; // a closed candle
+    // nrValues() values incl. the forming candle. false if not enough candles yet
+    virtual bool value(const IndicatorInput &in, double *values) const = 0;
+    virtual int nrValues() const { return 1; }
+};
+
+// Wilder smoothed relative strength index (0..100)
+class IndicatorRSI : public Indicator
+{
+public:
+    explicit IndicatorRSI(int period = 14);
+    int period() const { return _period; }
+    virtual void reset() override;
+    virtual void add(const IndicatorInput &in) override;
+    virtual bool value(const IndicatorInput &in, double *values) const override;
+private:
+    const int _period;
+    int _nrCloses; // added so far (up to _period+1)
+    double _lastClose;
+    double _avgGain; // sum of the gains until _period diffs are added
+    double _avgLoss; // same for the losses
+};
+
+// exponential moving average (k = 2/(period+1))
+class IndicatorEMA : public Indicator
+{
+public:
+    explicit IndicatorEMA(int period);
+    int period() const { return _period; }
+    virtual void reset() override;
+    virtual void add(const IndicatorInput &in) override { addValue(in._close); }
+    virtual bool value(const IndicatorInput &in, double *values) const override { return valueFor(in._close, *values); }
+    // on any series (e.g. the MACD line):
+    void addValue(const double &v);
+    bool valueFor(const double &v, double &ema) const; // incl. v as newest value
+    bool current(double &ema) const; // without a new value
+private:
+    const int _period;
+    const double _k;
+    int _nrValues; // added so far (up to _period)
+    double _ema; // sum of the values until _period are added
+};
+
+// MACD line (fast EMA - slow EMA), signal line (EMA of the MACD line) and histogram (MACD - signal)
+class IndicatorMACD : public Indicator
+{
+public:
+    IndicatorMACD(int fast, int slow, int signal);
+    virtual void reset() override;
+    virtual void add(const IndicatorInput &in) override;
+    virtual bool value(const IndicatorInput &in, double *values) const override;
+    virtual int nrValues() const override { return 3; }
+private:
+    IndicatorEMA _fast;
+    IndicatorEMA _slow;
+    IndicatorEMA _signal;
+};
+
+// Bollinger bands: middle (SMA), upper, lower (+/- factor * population std.dev.)
+class IndicatorBollinger : public Indicator
+{
+public:
+    IndicatorBollinger(int period, double factor);
+    virtual void reset() override;
+    virtual void add(const IndicatorInput &in) override;
+    virtual bool value(const IndicatorInput &in, double *values) const override;
+    virtual int nrValues() const override { return 3; }
+private:
+    const int _period;
+    const double _factor;
+    std::vector<double> _window; // newest _period-1 closes. circular
+    std::size_t _next; // position to write to once full
+    double _sum; // of _window
+    double _sumSq;
+};
+
+// average true range (Wilder smoothed)
+class IndicatorATR : public Indicator
+{
+public:
+    explicit IndicatorATR(int period = 14);
+    virtual void reset() override;
+    virtual void add(const IndicatorInput &in) override;
+    virtual bool value(const IndicatorInput &in, double *values) const override;
+private:
+    const int _period;
+    int _nrCandles; // added so far (up to _period+1)
+    double _lastClose;
+    double _atr; // sum of the true ranges until _period are added
+    double trueRange(const double &high, const double &low) const;
+};
+
+// volume weighted average price over the newest period candles
+class IndicatorVWAP : public Indicator
+{
+public:
+    explicit IndicatorVWAP(int period = 20);
+    virtual void reset() override;
+    virtual void add(const IndicatorInput &in) override;
+    virtual bool value(const IndicatorInput &in, double *values) const override;
+private:
+    const int _period;
+    std::vector<std::pair<double, double>> _window; // newest _period-1 (volume, quoteVolume). circular
+    std::size_t _next; // position to write to once full
+    double _volume; // of _window
+    double _quoteVolume;
+};
+
+#endif // INDICATORS_H
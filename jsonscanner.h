@@ -0,0 +1,152 @@
+#ifndef JSONSCANNER_H
+#define JSONSCANNER_H
+
+#include <QString>
+#include "decimal.h"
+
+/* minimal pull (SAX style) json scanner for the market data messages.
+ * Works directly on the characters of the QString we got from the websocket
+ * (no utf8 conversion, no DOM, no allocations). Strings are not unescaped
+ * (the market data doesn't use escapes) and numbers are only converted on request (see decimal.h).
+ * Separators (, and :) are skipped without checking. Anything unexpected gives
+ * Error so the caller can fall back to QJsonDocument.
+ */
+class JsonScanner
+{
+public:
+    enum Token { Error = 0, End, BeginArray, EndArray, BeginObject, EndObject, String, Number, True, False, Null };
+
+    explicit JsonScanner(const QString &s, int from = 0, int to = -1) :
+        _d(s.utf16()), _pos(from), _end(to < 0 ? s.length() : to), _token(Error), _tokBegin(0), _tokLen(0) {}
+
+    Token next()
+    {
+        while (_pos < _end) {
+            const ushort c = _d[_pos];
+            if (c == ' ' || c == ',' || c == ':' || c == '\n' || c == '\r' || c == '\t') { ++_pos; continue; }
+            _tokBegin = _pos++;
+            _tokLen = 1;
+            switch (c) {
+            case '[': return _token = BeginArray;
+            case ']': return _token = EndArray;
+            case '{': return _token = BeginObject;
+            case '}': return _token = EndObject;
+            case '"':
+                _tokBegin = _pos;
+                while (_pos < _end && _d[_pos] != '"') {
+                    if (_d[_pos] == '\\') ++_pos; // keep escapes as they are
+                    ++_pos;
+                }
+                if (_pos >= _end) return _token = Error;
+                _tokLen = _pos - _tokBegin;
+                ++_pos;
+                return _token = String;
+            case 't': return literal("true", True);
+            case 'f': return literal("false", False);
+            case 'n': return literal("null", Null);
+            default:
+                if (c == '-' || (c >= '0' && c <= '9')) {
+                    while (_pos < _end && isNumberChar(_d[_pos])) ++_pos;
+                    _tokLen = _pos - _tokBegin;
+                    return _token = Number;
+                }
+                return _token = Error;
+            }
+        }
+        return _token = End;
+    }
+
+    Token token() const { return _token; }
+    int pos() const { return _pos; } // behind the current token
+    int tokenBegin() const { return _tokBegin; } // current String (without quotes) or Number
+    int tokenLength() const { return _tokLen; }
+
+    bool equals(const char *ascii) const
+    {
+        int i = 0;
+        for (; ascii[i]; ++i)
+            if (i >= _tokLen || _d[_tokBegin + i] != (ushort)ascii[i]) return false;
+        return i == _tokLen;
+    }
+    QString toString() const { return QString((const QChar *)(_d + _tokBegin), _tokLen); } // allocates
+
+    // current Number or a number within a String (binance sends "0.00107340")
+    bool toDecimal(Decimal &d) const { return d.parse(_d + _tokBegin, _tokLen); }
+    double toDouble(bool *ok = 0) const
+    {
+        Decimal d;
+        if (toDecimal(d)) {
+            if (ok) *ok = true;
+            return d.toDouble();
+        }
+        return QString((const QChar *)(_d + _tokBegin), _tokLen).toDouble(ok); // exponent, long or invalid. rare
+    }
+    qint64 toInt64() const { return (qint64)toDouble(); } // ids, timestamps. exact up to 2^53
+
+    // skips the value of the current token. For BeginArray/BeginObject up to the matching end
+    bool skip()
+    {
+        if (_token != BeginArray && _token != BeginObject) return _token != Error && _token != End;
+        int depth = 1;
+        while (depth) {
+            switch (next()) {
+            case BeginArray:
+            case BeginObject: ++depth; break;
+            case EndArray:
+            case EndObject: --depth; break;
+            case Error:
+            case End: return false;
+            default: break;
+            }
+        }
+        return true;
+    }
+
+    // range of the next array/object (for multiple documents concatenated in one message).
+    // false at the end (begin == end) or if it's invalid/incomplete (begin .. end is the rest)
+    bool nextDocument(int &begin, int &end)
+    {
+        const Token t = next();
+        begin = t == End ? _end : _tokBegin;
+        end = _end;
+        if (t != BeginArray && t != BeginObject) return false;
+        if (!skip()) return false;
+        end = _pos;
+        return true;
+    }
+
+    // reads up to maxValues numbers of an array (after its BeginArray) incl. the EndArray.
+    // returns the number read or -1 if it contains anything else (or more values)
+    int readNumbers(double *values, int maxValues)
+    {
+        int n = 0;
+        while (next() == Number) {
+            if (n >= maxValues) return -1;
+            values[n++] = toDouble();
+        }
+        return _token == EndArray ? n : -1;
+    }
+
+private:
+    static bool isNumberChar(ushort c)
+    {
+        return (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+' || c == 'e' || c == 'E';
+    }
+    Token literal(const char *lit, Token t)
+    {
+        // first char already consumed
+        for (int i = 1; lit[i]; ++i, ++_pos)
+            if (_pos >= _end || _d[_pos] != (ushort)lit[i]) return _token = Error;
+        _tokLen = _pos - _tokBegin;
+        return _token = t;
+    }
+
+    const ushort *_d;
+    int _pos;
+    int _end;
+    Token _token;
+    int _tokBegin;
+    int _tokLen;
+};
+
+#endif // JSONSCANNER_H
@@ -2,7 +2,6 @@
  *
  * todo list:
  * - take rounding of prices/volumes for newOrder into account for s.arb.
- * - "bid > ask" problem on bitfinex. analyse and add sanity checks
  * - handling of heartbeat timeouts
  * - handling of maintenance periods
  * - add version info based on git tag/commit
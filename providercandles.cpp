@@ -1,113 +1,416 @@
 #include <cassert>
+#include <algorithm>
 #include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonArray>
 #include <chrono>
 #include <ratio>
 #include <ctime>
-#include <ta-lib/ta_func.h>
+#include <ta-lib/ta_func.h> // only for getRSI14TaLib()
 
 #include "providercandles.h"
+#include "decimal.h"
 
 ProviderCandles::ProviderCandles(std::shared_ptr<ChannelTrades> channel,
-                                 QObject *parent) : QObject(parent)
+                                 QObject *parent, std::size_t maxCandles) : QObject(parent)
   ,_channel(channel)
+  ,_nrUpdates(0)
+  ,_tradesSeq(0)
+  ,_dirty(false)
 {
     assert(_channel);
+    _candles.reserve(NrTimeframes);
+    for (int tf = M1; tf < NrTimeframes; ++tf)
+        _candles.emplace_back(maxCandles);
     connect(&(*_channel), SIGNAL(dataUpdated()), this, SLOT(channelDataUpdated()));
 }
 
+ProviderCandles::~ProviderCandles()
+{
+    _storeTimer.stop();
+    if (_storeFile.length())
+        saveCandles(_storeFile);
+}
+
+bool ProviderCandles::setStoreFile(const QString &fileName)
+{
+    _storeFile = fileName;
+    bool ret = loadCandles(_storeFile);
+    connect(&_storeTimer, SIGNAL(timeout()), this, SLOT(onStoreTimer()));
+    _storeTimer.start(5*60*1000); // we lose at most 5mins on a crash
+    return ret;
+}
+
+void ProviderCandles::onStoreTimer()
+{
+    saveCandles(_storeFile);
+}
+
+bool ProviderCandles::loadCandles(const QString &fileName, int maxGapSecs)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        qDebug() << __PRETTY_FUNCTION__ << tradePair() << "no candles at" << fileName;
+        return false;
+    }
+    QJsonDocument d = QJsonDocument::fromJson(file.readAll());
+    if (!d.isArray()) {
+        qWarning() << __PRETTY_FUNCTION__ << tradePair() << "no json array in" << fileName;
+        return false;
+    }
+    typedef std::chrono::duration<long long,std::milli> milliseconds_type;
+    std::vector<std::pair<TimePoint, CandlesItem>> loaded;
+    TimePoint newest;
+    const QJsonArray arr = d.array();
+    for (const auto &v : arr) {
+        const QJsonArray c = v.toArray();
+        if (c.size() < 5) continue;
+        TimePoint key;
+        key += milliseconds_type((qint64)c[0].toDouble());
+        key = bucketStart(key, M1);
+        if (key > newest) newest = key;
+        CandlesItem item;
+        item._tpOpen = key; // real trade times unknown. live trades within that minute are newer
+        item._tpClose = key;
+        if (c[1].isString()) { // binance: open time, "open", "high", "low", "close", "volume", close time,
+                               // "quote volume", nr trades, "taker buy volume",...
+            item._open = Decimal::toDouble(c[1]);
+            item._high = Decimal::toDouble(c[2]);
+            item._low = Decimal::toDouble(c[3]);
+            item._close = Decimal::toDouble(c[4]);
+            if (c.size() >= 10) {
+                item._volume = Decimal::toDouble(c[5]);
+                item._quoteVolume = Decimal::toDouble(c[7]);
+                item._nrTrades = c[8].toInt();
+                item._buyVolume = Decimal::toDouble(c[9]);
+            } else
+                item._tradeDetails = false;
+        } else { // bitfinex: MTS, OPEN, CLOSE, HIGH, LOW, VOLUME (+ ours: BUYVOLUME, QUOTEVOLUME, NRTRADES)
+            item._open = c[1].toDouble();
+            item._close = c[2].toDouble();
+            item._high = c[3].toDouble();
+            item._low = c[4].toDouble();
+            if (c.size() >= 9) {
+                item._volume = c[5].toDouble();
+                item._buyVolume = c[6].toDouble();
+                item._quoteVolume = c[7].toDouble();
+                item._nrTrades = c[8].toInt();
+            } else {
+                // bitfinex REST has no buy/sell split, quote volume or nr of trades. leave them unknown:
+                if (c.size() >= 6)
+                    item._volume = c[5].toDouble();
+                item._tradeDetails = false;
+            }
+        }
+        loaded.push_back(std::make_pair(key, item));
+    }
+    // the newest one has to be (at most maxGapSecs before) the previous minute. We can't
+    // fill the gap and continuing across it would only cause wrong indicators:
+    if (newest < bucketStart(std::chrono::system_clock::now() - std::chrono::seconds(60 + maxGapSecs), M1)) {
+        qWarning() << __PRETTY_FUNCTION__ << tradePair() << "candles in" << fileName << "too old. ignored";
+        return false;
+    }
+    // bitfinex REST returns the newest first. Insert the oldest first (O(1) appends):
+    std::sort(loaded.begin(), loaded.end(),
+              [](const std::pair<TimePoint, CandlesItem> &a, const std::pair<TimePoint, CandlesItem> &b) { return a.first < b.first; });
+    Candles &candles = _candles[M1];
+    int nrLoaded = 0;
+    for (const auto &l : loaded) {
+        std::size_t idx;
+        if (candles.find(l.first, idx))
+            continue; // live trades already. They can contain the stored ones (e.g. a trades snapshot)
+        if (!candles.insert(l.first, l.second))
+            continue; // older than the ones kept
+        if (!_dirty || l.first < _dirtyFrom) {
+            _dirtyFrom = l.first;
+            _dirty = true;
+        }
+        ++nrLoaded;
+    }
+    qDebug() << __PRETTY_FUNCTION__ << tradePair() << "loaded" << nrLoaded << "candles from" << fileName;
+    if (_dirty) {
+        rollUp();
+        updateIndicators();
+        _dirty = false;
+        emit dataUpdated();
+    }
+    return nrLoaded > 0;
+}
+
+bool ProviderCandles::saveCandles(const QString &fileName) const
+{
+    const Candles &candles = _candles[M1];
+    QJsonArray arr;
+    for (std::size_t i = 0; i < candles.size(); ++i) {
+        const CandlesItem &c = candles[i];
+        const qint64 mts = std::chrono::duration_cast<std::chrono::milliseconds>(candles.key(i).time_since_epoch()).count();
+        if (c._tradeDetails)
+            arr.append(QJsonArray({(double)mts, c._open, c._close, c._high, c._low, c._volume,
+                                   c._buyVolume, c._quoteVolume, c._nrTrades}));
+        else // stays unknown on the next load
+            arr.append(QJsonArray({(double)mts, c._open, c._close, c._high, c._low, c._volume}));
+    }
+    // write to a temp file first so that a crash doesn't leave us with a partial one:
+    QFile file(fileName + ".tmp");
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qWarning() << __PRETTY_FUNCTION__ << tradePair() << "couldn't open" << file.fileName();
+        return false;
+    }
+    file.write(QJsonDocument(arr).toJson(QJsonDocument::Compact));
+    file.close();
+    QFile::remove(fileName);
+    if (!QFile::rename(fileName + ".tmp", fileName)) {
+        qWarning() << __PRETTY_FUNCTION__ << tradePair() << "couldn't rename to" << fileName;
+        return false;
+    }
+    qDebug() << __PRETTY_FUNCTION__ << tradePair() << "saved" << candles.size() << "candles to" << fileName;
+    return true;
+}
+
 void ProviderCandles::channelDataUpdated()
 {
     //qDebug() << __PRETTY_FUNCTION__;
-    // calculate here and emit if new data is available
-    const ChannelTrades::TradesMap &trades = _channel->trades();
+    ++_nrUpdates;
+    // fold the trades added since the last call into the candles:
+    const ChannelTrades::Trades &trades = _channel->trades();
+    if (trades.seq() == _tradesSeq) return; // nothing new
+    std::size_t first = 0;
+    if (!trades.indexOfSeq(_tradesSeq, first)) {
+        // some were overwritten already (or cleared). take what we have:
+        if (trades.seq() - _tradesSeq > trades.size())
+            qWarning() << __PRETTY_FUNCTION__ << tradePair() << "missed" << (trades.seq() - _tradesSeq - trades.size()) << "trades";
+        first = 0;
+    }
+    for (std::size_t i = first; i < trades.size(); ++i)
+        addTrade(trades[i]);
+    _tradesSeq = trades.seq();
+    if (_dirty) {
+        rollUp();
+        updateIndicators();
+        _dirty = false;
+    }
+
+    //printCandles(true);
+
+    emit dataUpdated();
+}
+
+int ProviderCandles::timeframeSecs(Timeframe tf)
+{
+    static const int secs[NrTimeframes] = { 60, 5*60, 15*60, 60*60, 24*60*60 };
+    return secs[tf];
+}
 
-    // calculate candles based on trades
-    // we can't really rely on the order so we stop as soon as we found 3 matching candles
+const char *ProviderCandles::timeframeName(Timeframe tf)
+{
+    static const char *names[NrTimeframes] = { "1m", "5m", "15m", "1h", "1d" };
+    return names[tf];
+}
 
-    std::map<TimePoint, CandlesItem, std::greater<TimePoint>> tempCandles;
+bool ProviderCandles::timeframeFromName(const QString &name, Timeframe &tf)
+{
+    for (int t = M1; t < NrTimeframes; ++t) {
+        if (name == timeframeName((Timeframe)t)) {
+            tf = (Timeframe)t;
+            return true;
+        }
+    }
+    return false;
+}
+
+ProviderCandles::TimePoint ProviderCandles::bucketStart(const TimePoint &tp, Timeframe tf)
+{
+    // aligned to the epoch (so days start at 0:00 UTC). tp is >0:
+    return tp - (tp.time_since_epoch() % std::chrono::seconds(timeframeSecs(tf)));
+}
 
-    for (const auto &trade : trades) {
-        long long mts = trade.second._mts;
-        //typedef std::chrono::duration<long> seconds_type;
-        typedef std::chrono::duration<long, std::ratio<60>> minutes_type; // todo make 60 a parameter
-        typedef std::chrono::duration<long long,std::milli> milliseconds_type;
+void ProviderCandles::addTrade(const ChannelTrades::TradesItem &trade)
+{
+    typedef std::chrono::duration<long long,std::milli> milliseconds_type;
 
-        std::chrono::system_clock::time_point tp_mins;
-        tp_mins += std::chrono::duration_cast<minutes_type>( milliseconds_type(mts) ); // todo how shall be rounded?
+    std::chrono::system_clock::time_point tp;
+    tp += milliseconds_type(trade._mts);
+    const TimePoint tp_mins = bucketStart(tp, M1);
 
-        std::chrono::system_clock::time_point tp;
-        tp += milliseconds_type(mts);
+    const double price = _channel->toPrice(trade._price);
+    Candles &candles = _candles[M1];
+    // usually the trade belongs to the current (newest) candle:
+    std::size_t idx = candles.size() - 1;
+    bool found = !candles.empty() && candles.backKey() == tp_mins;
+    if (!found)
+        found = candles.find(tp_mins, idx); // a late trade for an older candle?
+    if (found)
+        candles.modify(idx, [&tp, &price, &trade](CandlesItem &c) { c.add(tp, price, trade._amount); }); // handles out of order trades within the candle as well
+    else if (!candles.insert(tp_mins, CandlesItem(tp, price, trade._amount))) {
+        qWarning() << __PRETTY_FUNCTION__ << tradePair() << "trade older than the candles kept. ignored";
+        return;
+    }
+    // the higher timeframes are updated from here on in rollUp():
+    if (!_dirty || tp_mins < _dirtyFrom) {
+        _dirtyFrom = tp_mins;
+        _dirty = true;
+    }
+}
 
-        // get candle in map:
-        auto it = tempCandles.find(tp_mins);
-        if (it != tempCandles.end()) {
-            it->second.add(tp, trade.second._price);
-        } else {
-            if (tempCandles.size()>20) break; // todo find better ways!
-            tempCandles.insert(std::make_pair(tp_mins, CandlesItem(tp, trade.second._price)));
+void ProviderCandles::rollUp()
+{
+    TimePoint from = _dirtyFrom;
+    for (int tf = M5; tf < NrTimeframes; ++tf) {
+        const Timeframe timeframe = (Timeframe)tf;
+        const Candles &lower = _candles[tf - 1];
+        Candles &upper = _candles[tf];
+        if (lower.empty()) return;
+        from = bucketStart(from, timeframe);
+        // rebuild the upper candles from the lower ones starting at the bucket of from:
+        std::size_t i = lower.size();
+        while (i > 0 && !(lower.key(i - 1) < from)) --i; // usually only a few newest ones
+        while (i < lower.size()) {
+            const TimePoint key = bucketStart(lower.key(i), timeframe);
+            CandlesItem c = lower[i];
+            for (++i; i < lower.size() && bucketStart(lower.key(i), timeframe) == key; ++i)
+                c.merge(lower[i]);
+            std::size_t idx;
+            if (upper.find(key, idx)) {
+                // if the start of the bucket might be dropped from the lower candles already we
+                // can only extend the prices of the existing one (the volume would be counted twice):
+                const bool partial = lower.size() == lower.capacity() && key < lower.key(0);
+                upper.modify(idx, [&c, partial](CandlesItem &u) { if (partial) u.mergePrices(c); else u = c; });
+            } else
+                upper.insert(key, c);
         }
+    }
+}
 
-        //std::time_t tt = std::chrono::system_clock::to_time_t(tp);
-        //qDebug() << "time_point tp is: " << ctime(&tt);
+int ProviderCandles::addIndicator(Timeframe tf, Indicator::Type type, int period, int period2, int period3, double factor)
+{
+    Indicator::normalizeParams(type, period, period2, period3, factor);
+    for (std::size_t id = 0; id < _indicators.size(); ++id) {
+        const IndicatorEntry &e = _indicators[id];
+        if (e._tf == tf && e._type == type && e._period == period && e._period2 == period2 &&
+                e._period3 == period3 && e._factor == factor)
+            return (int)id;
     }
-    //qDebug() << __PRETTY_FUNCTION__ << tempCandles.size();
+    IndicatorEntry e;
+    e._tf = tf;
+    e._type = type;
+    e._period = period;
+    e._period2 = period2;
+    e._period3 = period3;
+    e._factor = factor;
+    e._indicator = Indicator::create(type, period, period2, period3, factor);
+    e._hasAdded = false;
+    e._valid = false;
+    updateIndicator(e, false); // feed with the candles we have already
+    _indicators.push_back(std::move(e));
+    qDebug() << __PRETTY_FUNCTION__ << tradePair() << timeframeName(tf) << Indicator::typeName(type) << period << period2 << period3 << factor << "id" << (_indicators.size() - 1);
+    return (int)_indicators.size() - 1;
+}
 
-    // we need to update the (max 20) tempCandles in _candles
-    // go through all of them:
-    for (auto &cp : tempCandles) {
-        auto it = _candles.find(cp.first);
-        if (it != _candles.end()) {
-            // update _candles.
-            (*it).second = cp.second;
-        } else
-            _candles.insert(cp);// we grow indefinetly for now (todo)
+bool ProviderCandles::indicatorValue(int id, double &value, int which) const
+{
+    assert(id >= 0 && (std::size_t)id < _indicators.size());
+    const IndicatorEntry &e = _indicators[id];
+    assert(which < e._indicator->nrValues());
+    if (!e._valid) return false;
+    value = e._values[which];
+    return true;
+}
+
+static IndicatorInput indicatorInput(const ProviderCandles::CandlesItem &c)
+{
+    IndicatorInput in;
+    in._high = c._high;
+    in._low = c._low;
+    in._close = c._close;
+    // candles without a known quote volume don't count for the vwap:
+    in._volume = c._tradeDetails ? c._volume : 0.0;
+    in._quoteVolume = c._tradeDetails ? c._quoteVolume : 0.0;
+    return in;
+}
+
+void ProviderCandles::updateIndicator(IndicatorEntry &e, bool reset)
+{
+    const Candles &candles = _candles[e._tf];
+    if (candles.empty()) return;
+    if (reset) {
+        e._indicator->reset();
+        e._hasAdded = false;
+    }
+    // add the candles closed meanwhile (all but the newest one):
+    std::size_t i = candles.size() - 1;
+    if (e._hasAdded)
+        while (i > 0 && e._lastAdded < candles.key(i - 1)) --i;
+    else
+        i = 0;
+    for (; i + 1 < candles.size(); ++i) {
+        e._indicator->add(indicatorInput(candles[i]));
+        e._lastAdded = candles.key(i);
+        e._hasAdded = true;
     }
+    e._valid = e._indicator->value(indicatorInput(candles.back()), e._values);
+}
 
-    //printCandles(true);
+void ProviderCandles::updateIndicators()
+{
+    for (auto &e : _indicators) {
+        // a late trade changed an already added candle? restart with the candles kept (rare):
+        const bool reset = e._hasAdded && !(e._lastAdded < bucketStart(_dirtyFrom, e._tf));
+        updateIndicator(e, reset);
+    }
+}
 
-    emit dataUpdated();
+QString ProviderCandles::getStatusMsg() const
+{
+    QString msg = QString("candles");
+    for (int tf = M1; tf < NrTimeframes; ++tf)
+        msg.append(QString(" %1:%2").arg(timeframeName((Timeframe)tf)).arg(_candles[tf].size()));
+    msg.append(QString(" (max %1), updates %2, indicators %3").arg(_candles[M1].capacity()).arg(_nrUpdates).arg(_indicators.size()));
+    return msg;
 }
 
 void ProviderCandles::printCandles(bool details) const
 {
-    qDebug() << "Candles #" << _candles.size() << "(o h l c) rsi=" << getRSI14();
+    const Candles &candles = _candles[M1];
+    qDebug() << "Candles #" << candles.size() << "(o h l c) TA_RSI=" << getRSI14TaLib();
+    for (std::size_t id = 0; id < _indicators.size(); ++id) {
+        const IndicatorEntry &e = _indicators[id];
+        qDebug() << " " << timeframeName(e._tf) << Indicator::typeName(e._type) << e._period << (e._valid ? e._values[0] : 0.0);
+    }
     if (!details) return;
-    int i=0;
-    for (auto &candleIt : _candles) {
-        ++i;
-        if (i>14) { qDebug() << "..."; break; }
-        const CandlesItem &candle = candleIt.second;
+    for (std::size_t i = 0; i < candles.size(); ++i) {
+        if (i>=14) { qDebug() << "..."; break; }
+        const CandlesItem &candle = candles[candles.size() - 1 - i]; // newest first
         std::time_t tt = std::chrono::system_clock::to_time_t(candle._tpClose);
         //qDebug() << "time_point tp is: " << ctime(&tt);
 
         char buf[12];
         std::strftime(buf, sizeof(buf), "%H:%M:%S", std::localtime(&tt));
-        qDebug() << buf << candle._open << candle._high << candle._low << candle._close;
+        qDebug() << buf << candle._open << candle._high << candle._low << candle._close
+                 << "vol" << candle._volume << "buy" << (candle._tradeDetails ? candle._buyVolume : -1.0)
+                 << "vwap" << candle.vwap() << "#" << candle._nrTrades;
     }
 }
 
-double ProviderCandles::getRSI14() const
+double ProviderCandles::getRSI14TaLib(Timeframe tf) const
 {
     double rsi=-1.0;
+    const Candles &candles = _candles[tf];
 
-    if (_candles.size()<15) return rsi - (_candles.size());
+    if (candles.size()<15) return rsi - (candles.size());
 
-    TA_Real closePrices[15];
-    TA_Real out[15];
+    std::vector<TA_Real> out(candles.size());
     TA_Integer outBeg;
     TA_Integer outNbElement;
 
-    // for now feed with last 15 trades
-    int i=14;
-    for (const auto &item : _candles) {
-        closePrices[i] = item.second._close;
-        if (i==0) break; else --i;
-    }
+    // all closes kept (contiguous, no copy needed). The incremental one might have seen
+    // older candles already but the Wilder smoothing forgets them quickly:
+    const TA_Real *closePrices = candles.lastCloses(candles.size());
     /*
     QString ins;
     for (int i=0; i<15; ++i) ins.append(QString("%1 ").arg(closePrices[i])); */
 
-    TA_RetCode retCode = TA_RSI(0, 14,
+    TA_RetCode retCode = TA_RSI(0, (int)candles.size() - 1,
                                 &closePrices[0], 14,
             &outBeg, &outNbElement, &out[0]);
 
@@ -2,30 +2,74 @@
 #define PROVIDERCANDLES_H
 
 #include <memory>
+#include <vector>
 #include <chrono>
 #include <QObject>
+#include <QTimer>
 
 #include "channel.h"
+#include "candleseries.h"
+#include "indicators.h"
 
 static QString unset("unset");
 
+/* candles from a ChannelTrades for several timeframes at once.
+ * The trades are only added to the 1min candles. The higher timeframes are
+ * rolled up from the next lower one (5m from 1m, 15m from 5m,...) for the
+ * candles that changed.
+ */
 class ProviderCandles : public QObject
 {
     Q_OBJECT
 public:
-    explicit ProviderCandles(std::shared_ptr<ChannelTrades> exchange, QObject *parent = 0);
+    explicit ProviderCandles(std::shared_ptr<ChannelTrades> exchange, QObject *parent = 0,
+                             std::size_t maxCandles = 2048); // retention per timeframe. ~34h of 1min candles
+    virtual ~ProviderCandles();
+
+    enum Timeframe { M1 = 0, M5, M15, H1, D1, NrTimeframes }; // each a multiple of the previous one
+    static int timeframeSecs(Timeframe tf);
+    static const char *timeframeName(Timeframe tf);
+    static bool timeframeFromName(const QString &name, Timeframe &tf); // "1m", "5m",...
 
     void printCandles(bool details) const;
+    QString getStatusMsg() const;
     const QString &tradePair() const { return _channel ? _channel->symbol() : unset; }
     typedef std::chrono::system_clock::time_point TimePoint;
 
     class CandlesItem
     {
     public:
-        CandlesItem(const TimePoint &tp, const double &price) :
-            _tpOpen(tp), _tpClose(tp), _open(price), _close(price), _high(price), _low(price) {}
+        CandlesItem() : _open(0.0), _close(0.0), _high(0.0), _low(0.0),
+            _volume(0.0), _buyVolume(0.0), _quoteVolume(0.0), _nrTrades(0), _tradeDetails(true) {}
+        CandlesItem(const TimePoint &tp, const double &price, const double &amount) :
+            _tpOpen(tp), _tpClose(tp), _open(price), _close(price), _high(price), _low(price),
+            _volume(0.0), _buyVolume(0.0), _quoteVolume(0.0), _nrTrades(0), _tradeDetails(true) { addVolume(price, amount); }
 
-        void add(const TimePoint &tp, const double &price) {
+        void merge(const CandlesItem &o) { // o from the same timeframe bucket. o's trades are not in here yet
+            mergePrices(o);
+            _volume += o._volume;
+            _buyVolume += o._buyVolume;
+            _quoteVolume += o._quoteVolume;
+            _nrTrades += o._nrTrades;
+            _tradeDetails = _tradeDetails && o._tradeDetails;
+        }
+        void mergePrices(const CandlesItem &o) { // only open/close/high/low
+            if (o._tpOpen < _tpOpen) {
+                _tpOpen = o._tpOpen;
+                _open = o._open;
+            }
+            if (o._tpClose > _tpClose) {
+                _tpClose = o._tpClose;
+                _close = o._close;
+            }
+            if (o._high > _high)
+                _high = o._high;
+            if (o._low < _low)
+                _low = o._low;
+        }
+
+        void add(const TimePoint &tp, const double &price, const double &amount) {
+            addVolume(price, amount);
             if (tp < _tpOpen) {
                 _tpOpen = tp;
                 _open = price;
@@ -40,27 +84,87 @@ public:
                 _low = price;
         }
 
+        double sellVolume() const { return _volume - _buyVolume; } // only if _tradeDetails
+        double vwap() const { return _tradeDetails && _volume > 0.0 ? _quoteVolume / _volume : _close; }
+
         TimePoint _tpOpen;
         TimePoint _tpClose;
         double _open;
         double _close;
         double _high;
         double _low;
+        double _volume; // sum of the trade amounts (positive)
+        double _buyVolume; // part of _volume from trades where the taker bought
+        double _quoteVolume; // sum of price*amount. for vwap()
+        int _nrTrades;
+        bool _tradeDetails; // _buyVolume, _quoteVolume and _nrTrades known. not for plain bitfinex REST candles
+    private:
+        void addVolume(const double &price, const double &amount) {
+            const double a = amount < 0.0 ? -amount : amount;
+            _volume += a;
+            if (amount > 0.0) _buyVolume += a;
+            _quoteVolume += price * a;
+            ++_nrTrades;
+        }
     };
 
-    typedef std::map<TimePoint, CandlesItem, std::greater<TimePoint>> CandlesMap;
-    double getRSI14() const; // todo remove
-    const CandlesMap &candles() const { return _candles; }
+    typedef CandleSeries<TimePoint, CandlesItem> Candles; // by open time. oldest first
+    double getRSI14TaLib(Timeframe tf = M1) const; // TA_RSI over all candles kept. to cross check the RSI indicator
+
+    /* shared indicators. Strategies request one with its parameters (see Indicator::create)
+     * and get an id to query the value. Identical requests get the same id, so each
+     * indicator is only computed once per candle update no matter how many use it. */
+    int addIndicator(Timeframe tf, Indicator::Type type, int period = 0, int period2 = 0, int period3 = 0, double factor = 0.0);
+    bool indicatorValue(int id, double &value, int which = 0) const; // which < Indicator::nrValues(). false if not enough candles yet
+    std::size_t nrIndicators() const { return _indicators.size(); }
+    const Candles &candles(Timeframe tf = M1) const { return _candles[tf]; }
+
+    /* candle store to be live right after a (re)start: loads the 1min candles from
+     * fileName (if no minute is missing up to now) and saves them there every few minutes and on destruction. */
+    bool setStoreFile(const QString &fileName);
+    // json array of [MTS, OPEN, CLOSE, HIGH, LOW, VOLUME,...] (bitfinex REST candles) or binance klines.
+    // ignored if more than maxGapSecs of candles are missing up to now (the indicators would continue
+    // across the gap). Candles of minutes with live trades already are skipped (no double counting).
+    bool loadCandles(const QString &fileName, int maxGapSecs = 60);
+    bool saveCandles(const QString &fileName) const; // bitfinex REST format + BUYVOLUME, QUOTEVOLUME, NRTRADES
 
 signals:
     void dataUpdated();
 public slots:
     void channelDataUpdated();
+    void onStoreTimer();
 
 protected:
+    QString _storeFile;
+    QTimer _storeTimer;
 
     std::shared_ptr<ChannelTrades> _channel;
-    CandlesMap _candles;
+    std::vector<Candles> _candles; // by Timeframe
+    quint64 _nrUpdates;
+    quint64 _tradesSeq; // trades().seq() already added to the candles
+    TimePoint _dirtyFrom; // oldest 1min candle changed since the last rollUp()
+    bool _dirty;
+    static TimePoint bucketStart(const TimePoint &tp, Timeframe tf);
+    void addTrade(const ChannelTrades::TradesItem &trade);
+    void rollUp();
+
+    // registered indicators. Only closed candles are added to them:
+    class IndicatorEntry
+    {
+    public:
+        Timeframe _tf;
+        Indicator::Type _type;
+        int _period, _period2, _period3;
+        double _factor;
+        std::unique_ptr<Indicator> _indicator;
+        bool _hasAdded;
+        TimePoint _lastAdded; // key of the newest candle added
+        bool _valid;
+        double _values[Indicator::MaxValues]; // cached values incl. the current candle
+    };
+    std::vector<IndicatorEntry> _indicators; // by id
+    void updateIndicator(IndicatorEntry &e, bool reset);
+    void updateIndicators();
 };
 
 #endif // PROVIDERCANDLES_H
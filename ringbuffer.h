@@ -0,0 +1,64 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+
+/* fixed capacity circular buffer. push_back() overwrites the oldest element once full.
+ * Index 0 is the oldest element, size()-1 the newest (back()).
+ * seq() counts all elements ever pushed (not reset by clear()), so the element at
+ * index i has the sequence number seq()-size()+i. Consumers can remember seq() and
+ * process only the newer elements later on (if not overwritten meanwhile).
+ */
+template <class T>
+class RingBuffer
+{
+public:
+    explicit RingBuffer(std::size_t capacity) : _mask(0), _head(0), _seq(0)
+    {
+        std::size_t cap = 1;
+        while (cap < capacity) cap <<= 1; // power of 2 so we can mask instead of modulo
+        _mask = cap - 1;
+        _buf.reserve(cap);
+    }
+
+    std::size_t capacity() const { return _mask + 1; }
+    std::size_t size() const { return _buf.size(); }
+    bool empty() const { return _buf.empty(); }
+    void clear() { _buf.clear(); _head = 0; } // keeps seq()
+    std::uint64_t seq() const { return _seq; }
+
+    void push_back(const T &item)
+    {
+        if (_buf.size() < capacity()) {
+            _buf.push_back(item);
+        } else {
+            _buf[_head] = item; // overwrite the oldest
+            _head = (_head + 1) & _mask;
+        }
+        ++_seq;
+    }
+
+    const T &operator[](std::size_t i) const { assert(i < _buf.size()); return _buf[(_head + i) & _mask]; }
+    T &operator[](std::size_t i) { assert(i < _buf.size()); return _buf[(_head + i) & _mask]; }
+    const T &back() const { return (*this)[_buf.size() - 1]; } // newest. must not be empty
+
+    // index of the element with sequence number s. false if not (or no longer) contained
+    bool indexOfSeq(std::uint64_t s, std::size_t &index) const
+    {
+        std::uint64_t first = _seq - _buf.size();
+        if (s < first || s >= _seq) return false;
+        index = (std::size_t)(s - first);
+        return true;
+    }
+
+private:
+    std::vector<T> _buf;
+    std::size_t _mask;
+    std::size_t _head; // index of the oldest element once full
+    std::uint64_t _seq;
+};
+
+#endif // RINGBUFFER_H
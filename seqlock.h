@@ -0,0 +1,70 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/* single writer / multiple reader sequence lock for a trivially copyable T.
+ * The writer never blocks. Readers copy the data and retry if the writer
+ * was active meanwhile, so they never see a torn (partially written) value.
+ * The payload is stored in atomic words so that the concurrent copies are
+ * no data race (and thus well defined).
+ * store() must only be called from one thread at a time (the owner thread).
+ */
+template <class T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+public:
+    SeqLock() : _seq(0)
+    {
+        for (auto &w : _words)
+            w.store(0, std::memory_order_relaxed);
+    }
+    SeqLock(const SeqLock &) = delete;
+    SeqLock &operator=(const SeqLock &) = delete;
+
+    void store(const T &value)
+    {
+        std::uint64_t buf[NrWords] = {};
+        std::memcpy(buf, &value, sizeof(T));
+        const std::uint64_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed); // odd -> write in progress
+        // release: the odd seq can't be reordered after the words (free on x86)
+        for (std::size_t i = 0; i < NrWords; ++i)
+            _words[i].store(buf[i], std::memory_order_release);
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // single attempt. returns false if a write was in progress
+    bool tryLoad(T &value) const
+    {
+        const std::uint64_t seq1 = _seq.load(std::memory_order_acquire);
+        if (seq1 & 1) return false;
+        std::uint64_t buf[NrWords];
+        // acquire: the 2nd seq read can't be reordered before the words
+        for (std::size_t i = 0; i < NrWords; ++i)
+            buf[i] = _words[i].load(std::memory_order_acquire);
+        if (_seq.load(std::memory_order_relaxed) != seq1) return false;
+        std::memcpy(&value, buf, sizeof(T));
+        return true;
+    }
+
+    // retries until a consistent copy is read. The writer is never blocked.
+    void load(T &value) const
+    {
+        while (!tryLoad(value))
+            ;
+    }
+
+    std::uint64_t sequence() const { return _seq.load(std::memory_order_acquire); } // even: stable
+
+private:
+    static const std::size_t NrWords = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+    std::atomic<std::uint64_t> _seq;
+    std::atomic<std::uint64_t> _words[NrWords];
+};
+
+#endif // SEQLOCK_H
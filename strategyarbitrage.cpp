@@ -160,6 +160,7 @@ void StrategyArbitrage::announceChannelBook(std::shared_ptr<ChannelBooks> book)
         if (e._book) return; // have it already
         if (e._pair == book->symbol()) {
             e._book = book;
+            _consBook.addBook(book);
             qCDebug(CsArb) << __PRETTY_FUNCTION__ << _id << "have book for" << e._name << e._pair;
         }
     }
@@ -208,20 +209,26 @@ void StrategyArbitrage::timerEvent(QTimerEvent *event)
         // let's do simply an additional loop. not efficient, but for now easier:
         _csvStream << QDateTime::currentDateTime().toString("dd.MM.yy hh:mm:ss") << ',';
         for (const auto &e: _exchgs) {
-            // we use the min amount for now (todo check with avail amount)
-            double priceBid=0.0, priceAsk=0.0;
-            const ExchgData &e1 = e.second;
-            double amount = 0.000001;
-            double avg;
-            e1._book->getPrices(false, amount, avg, priceBid);
-            e1._book->getPrices(true, amount, avg, priceAsk);
-            _csvStream << priceBid << ',' << priceAsk << ',';
+            // we use the top of book for now (todo check with avail amount)
+            const ChannelBooks::TopOfBook &top = e.second._book->topOfBook();
+            _csvStream << top._bidPrice << ',' << top._askPrice << ',';
         }
         _csvStream << "\n";
         if (QDateTime::currentMSecsSinceEpoch()%60000==0)
             _csvStream.flush();
     }
 
+    // quick check on the best prices of all books first. If no bid is above an ask from another
+    // exchange none of the pairs below can trade (but we still want their status):
+    const bool crossed = _consBook.isCrossedAcrossSources();
+    if (!crossed) {
+        ConsolidatedBook::Level bid, ask;
+        if (_consBook.bestBid(bid) && _consBook.bestAsk(ask))
+            _lastStatus = QString("best bid %1 (%2) <= best ask %3 (%4)")
+                    .arg(bid._price).arg(_consBook.sourceName(bid._source))
+                    .arg(ask._price).arg(_consBook.sourceName(ask._source));
+    }
+
     for ( auto it1 = _exchgs.begin(); it1 != _exchgs.end(); ++it1) {
         // order pending?
         ExchgData &e1 = (*it1).second;
@@ -340,7 +347,7 @@ void StrategyArbitrage::timerEvent(QTimerEvent *event)
                         //_lastStatus.append(QString("\nbuy %1 %8 at %2%6, sell %3 at %4%7, delta %5%")
                         //                   .arg(eBuy._name).arg(priceBuy).arg(eSell._name).arg(priceSell).arg(deltaPerc)
                         //                   .arg(eBuy._cur2).arg(eSell._cur2).arg(eBuy._cur1));
-                        if (deltaPerc >= (_MinDeltaPerc+sumFeePerc)) {
+                        if (crossed && deltaPerc >= (_MinDeltaPerc+sumFeePerc)) {
 
                             RoundingDouble rAmountSellCur1 = eSell._e->getRounding(eSell._pair, false); // initialized with minAmount allowed
                             if (maxAmountSell < rAmountSellCur1) {
@@ -6,6 +6,7 @@
 #include <QFile>
 #include "tradestrategy.h"
 #include "exchange.h"
+#include "consolidatedbook.h"
 
 Q_DECLARE_LOGGING_CATEGORY(CsArb)
 
@@ -48,6 +49,7 @@ protected:
     };
     void appendLastStatus(QString &lastStatus, const ExchgData &e1, const ExchgData &e2, const double &delta) const;
     std::map<QString, ExchgData> _exchgs;
+    ConsolidatedBook _consBook; // all books of _exchgs
 
     void timerEvent(QTimerEvent *event) override;
     int _timerId;
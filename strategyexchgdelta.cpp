@@ -143,6 +143,18 @@ void StrategyExchgDelta::announceChannelBook(std::shared_ptr<ChannelBooks> book)
 
 }
 
+// limit price for amount or simply the top of book if we have nothing
+static bool getLimitPrice(const ChannelBooks &book, bool ask, const double &amount, double &price)
+{
+    if (amount > 0.0) {
+        double avg;
+        return book.getPrices(ask, amount, avg, price);
+    }
+    const ChannelBooks::TopOfBook &top = book.topOfBook();
+    price = ask ? top._askPrice : top._bidPrice;
+    return price > 0.0;
+}
+
 void StrategyExchgDelta::timerEvent(QTimerEvent *event)
 {
     (void)event;
@@ -162,24 +174,20 @@ void StrategyExchgDelta::timerEvent(QTimerEvent *event)
     }
 
 
-    double price1Buy, price1Sell, price2Buy, price2Sell, avg;
+    double price1Buy, price1Sell, price2Buy, price2Sell;
     double amount = _exchg[1]._availCur1 * 1.0042; // how much we buy depends on how much we have on the other todo factor see below
-    if (amount <= 0.0) amount = 0.000001; // if we ask for 0 we get !ok
-    bool ok = _exchg[0]._book->getPrices(true, amount, avg, price1Buy); // ask
+    bool ok = getLimitPrice(*_exchg[0]._book, true, amount, price1Buy); // ask
     if (!ok) return;
     amount = _exchg[0]._availCur1;
-    if (amount <= 0.0) amount = 0.000001; // if we ask for 0 we get !ok
-    ok = _exchg[0]._book->getPrices(false, amount, avg, price1Sell); // Bid
+    ok = getLimitPrice(*_exchg[0]._book, false, amount, price1Sell); // Bid
     if (!ok) return;
 
     amount = _exchg[0]._availCur1 * 1.0042; ; // todo factor
-    if (amount <= 0.0) amount = 0.000001; // if we ask for 0 we get !ok
-    ok = _exchg[1]._book->getPrices(true, amount, avg, price2Buy); // ask
+    ok = getLimitPrice(*_exchg[1]._book, true, amount, price2Buy); // ask
     if (!ok) return;
 
     amount = _exchg[1]._availCur1;
-    if (amount <= 0.0) amount = 0.000001; // if we ask for 0 we get !ok
-    ok = _exchg[1]._book->getPrices(false, amount, avg, price2Sell); // bid
+    ok = getLimitPrice(*_exchg[1]._book, false, amount, price2Sell); // bid
     if (!ok) return;
 
     if (price2Buy == 0.0) { // todo sell?
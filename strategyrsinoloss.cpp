@@ -7,13 +7,16 @@
 
 StrategyRSINoLoss::StrategyRSINoLoss(const QString &exchange, const QString &id, const QString &tradePair, const double &buyValue,
                                      const double &rsiBuy, const double &rsiHold, std::shared_ptr<ProviderCandles> provider, QObject *parent,
-                                     bool generateMakerPrices, double marginFactor, bool useBookPrices, double sellFactor) :
+                                     bool generateMakerPrices, double marginFactor, bool useBookPrices, double sellFactor,
+                                     const QString &timeframe) :
     TradeStrategy(id, QString("cryptotrader_strategyrsinoloss%1").arg(id), parent)
   , _exchange(exchange)
   , _tradePair(tradePair)
   , _generateMakerPrices(generateMakerPrices)
   , _useBookPrices(useBookPrices)
   , _providerCandles(provider)
+  , _timeframe(ProviderCandles::M1)
+  , _rsiId(-1)
   , _valueBought(0.0)
   , _valueSold(0.0)
   , _lastRSI(-1.0)
@@ -41,10 +44,24 @@ StrategyRSINoLoss::StrategyRSINoLoss(const QString &exchange, const QString &id,
         qDebug() << "providerCandles tradePair=" << _providerCandles->tradePair();
         assert( _providerCandles->tradePair() == _tradePair);
     }
+    QString tf = timeframe.length() ? timeframe : _settings.value("Timeframe", QString("1m")).toString();
+    if (!setTimeframe(tf)) {
+        qWarning() << __PRETTY_FUNCTION__ << _id << "unknown timeframe" << tf << "using 1m";
+        setTimeframe(QString("1m"));
+    }
     connect(&(*_providerCandles), SIGNAL(dataUpdated()),
             this, SLOT(onCandlesUpdated()));
 }
 
+bool StrategyRSINoLoss::setTimeframe(const QString &timeframe)
+{
+    ProviderCandles::Timeframe tf;
+    if (!ProviderCandles::timeframeFromName(timeframe, tf)) return false;
+    _timeframe = tf;
+    _rsiId = _providerCandles->addIndicator(tf, Indicator::RSI, 14);
+    return true;
+}
+
 StrategyRSINoLoss::~StrategyRSINoLoss()
 {
     qDebug() << __PRETTY_FUNCTION__ << _id;
@@ -68,9 +85,12 @@ void StrategyRSINoLoss::onCandlesUpdated()
 {
     if (_halted) return;
     if (_paused) return;
-    double rsi = _providerCandles->getRSI14();
+    const ProviderCandles::Timeframe tf = (ProviderCandles::Timeframe)_timeframe;
+    if (_providerCandles->candles(tf).empty()) return; // no price yet
+    double rsi = -1.0; // invalid
+    _providerCandles->indicatorValue(_rsiId, rsi);
     _lastRSI = rsi;
-    double curPrice = _providerCandles->candles().begin()->second._close;
+    double curPrice = _providerCandles->candles(tf).back()._close;
     _lastPrice = curPrice;
     // ask books for estimated price for our intended volume here!
     double avgAskPrice = curPrice;
@@ -206,7 +226,10 @@ QString StrategyRSINoLoss::getStatusMsg() const
             msg.append(QString(" waiting for RSI < %1\n").arg(_rsiBuy));
         }
     }
-    msg.append(QString(" last price was %1 and RSI %2.").arg(_lastPrice).arg(_lastRSI));
+    msg.append(QString(" last price was %1 and RSI %2 (%3).").arg(_lastPrice).arg(_lastRSI)
+               .arg(ProviderCandles::timeframeName((ProviderCandles::Timeframe)_timeframe)));
+    if (_providerCandles)
+        msg.append(QString("\n %1").arg(_providerCandles->getStatusMsg()));
     return msg;
 }
 
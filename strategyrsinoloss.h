@@ -12,7 +12,8 @@ class StrategyRSINoLoss : public TradeStrategy
 public:
     explicit StrategyRSINoLoss(const QString &exchange, const QString &id, const QString &tradePair, const double &buyValue,
                                const double &rsiBuy, const double &rsiHold,
-                               std::shared_ptr<ProviderCandles> provider, QObject *parent = 0, bool generateMakerPrices=true, double marginFactor=1.006, bool useBookPrices=false, double sellFactor = 1.0);
+                               std::shared_ptr<ProviderCandles> provider, QObject *parent = 0, bool generateMakerPrices=true, double marginFactor=1.006, bool useBookPrices=false, double sellFactor = 1.0,
+                               const QString &timeframe = QString()); // candles for the RSI e.g. "5m". empty: setting "Timeframe" or "1m"
     virtual ~StrategyRSINoLoss();
     virtual void announceChannelBook(std::shared_ptr<ChannelBooks> book) override;
     void setChannelBook(std::shared_ptr<ChannelBooks> book);
@@ -21,6 +22,7 @@ public:
     const QString &tradePair() const { return _tradePair; }
     virtual QString onNewBotMessage(const QString &msg) override;
     virtual bool usesExchange(const QString &exc) const override { return exchange() == exc; }
+    bool setTimeframe(const QString &timeframe); // candles the RSI is calculated on (ProviderCandles::timeframeName)
 signals:
 public slots:
     virtual void onFundsUpdated(QString exchange, double amount, double price, QString pair, double fee, QString feeCur) override;
@@ -31,6 +33,8 @@ protected:
     bool _generateMakerPrices;
     bool _useBookPrices;
     std::shared_ptr<ProviderCandles> _providerCandles;
+    int _timeframe; // ProviderCandles::Timeframe
+    int _rsiId; // RSI14 indicator at _providerCandles
     std::shared_ptr<ChannelBooks> _channelBook;
 
     double _valueBought;
@@ -0,0 +1,92 @@
+#ifndef STREAMROUTES_H
+#define STREAMROUTES_H
+
+#include <vector>
+#include <cstring>
+#include <QString>
+
+/* hash table from stream names (e.g. binance "bnbbtc@depth") to a Route (target channel and
+ * message kind). Filled once when subscribing, so dispatching a message is a single lookup
+ * on the raw characters of the stream name (no QString, no split/toUpper, no map compares).
+ * Open addressing with linear probing, kept at most half full.
+ */
+template <class Route>
+class StreamRoutes
+{
+public:
+    StreamRoutes() : _size(0) {}
+
+    void clear() { _table.clear(); _size = 0; }
+    std::size_t size() const { return _size; }
+
+    void insert(const QString &name, const Route &route)
+    {
+        if (2 * (_size + 1) > _table.size())
+            rehash(_table.empty() ? 16 : 2 * _table.size());
+        const quint32 h = hash(name.utf16(), name.length());
+        Entry &e = _table[slot(name.utf16(), name.length(), h)];
+        if (!e._used) {
+            e._used = true;
+            e._hash = h;
+            e._name = name;
+            ++_size;
+        }
+        e._route = route;
+    }
+
+    const Route *find(const ushort *name, int len) const
+    {
+        if (_table.empty()) return 0;
+        const Entry &e = _table[slot(name, len, hash(name, len))];
+        return e._used ? &e._route : 0;
+    }
+    const Route *find(const QString &name) const { return find(name.utf16(), name.length()); }
+
+private:
+    class Entry
+    {
+    public:
+        Entry() : _used(false), _hash(0) {}
+        bool _used;
+        quint32 _hash;
+        QString _name;
+        Route _route;
+    };
+    std::vector<Entry> _table; // size power of 2
+    std::size_t _size;
+
+    static quint32 hash(const ushort *p, int len)
+    {
+        quint32 h = 2166136261u; // FNV-1a
+        for (int i = 0; i < len; ++i) {
+            h ^= p[i];
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    // index of the entry with this name or of the free one to use for it
+    std::size_t slot(const ushort *name, int len, quint32 h) const
+    {
+        const std::size_t mask = _table.size() - 1;
+        for (std::size_t i = h & mask; ; i = (i + 1) & mask) {
+            const Entry &e = _table[i];
+            if (!e._used) return i;
+            if (e._hash == h && e._name.length() == len &&
+                    !std::memcmp(e._name.utf16(), name, len * sizeof(ushort)))
+                return i;
+        }
+    }
+
+    void rehash(std::size_t newSize)
+    {
+        std::vector<Entry> old;
+        old.swap(_table);
+        _table.resize(newSize);
+        _size = 0;
+        for (const Entry &e : old)
+            if (e._used) insert(e._name, e._route);
+    }
+};
+
+#endif // STREAMROUTES_H
@@ -0,0 +1,34 @@
+#ifndef TESTEXCHANGE_H
+#define TESTEXCHANGE_H
+
+#include "exchange.h"
+
+// exchange without any connection. Only to create channels in the tests
+class TestExchange : public Exchange
+{
+public:
+    explicit TestExchange(QObject *parent = 0) : Exchange(parent, "cryptotrader_test"), _name("test") {}
+    const QString &name() const override { return _name; }
+    int newOrder(const QString &symbol, const double &amount, const double &price,
+                 const QString &type="EXCHANGE LIMIT", int hidden=0) override
+    {
+        (void)symbol; (void)amount; (void)price; (void)type; (void)hidden;
+        return -1;
+    }
+    QString getStatusMsg() const override { return _name; }
+    void reconnect() override {}
+    bool getAvailable(const QString &cur, double &available) const override { (void)cur; available = 0.0; return false; }
+    RoundingDouble getRounding(const QString &pair, bool price) const override { (void)pair; (void)price; return RoundingDouble(0.0, 8); }
+    bool getMinAmount(const QString &pair, double &amount) const override { (void)pair; amount = 0.0; return false; }
+    bool getMinOrderValue(const QString &pair, double &minValue) const override { (void)pair; minValue = 0.0; return false; }
+    bool getFee(bool buy, const QString &pair, double &feeCur1, double &feeCur2, double amount = 0.0, bool makerFee=false) override
+    {
+        (void)buy; (void)pair; (void)amount; (void)makerFee;
+        feeCur1 = feeCur2 = 0.0;
+        return false;
+    }
+private:
+    QString _name;
+};
+
+#endif // TESTEXCHANGE_H
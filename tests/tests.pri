@@ -0,0 +1,12 @@
+# common settings of the unit tests. Each test builds the app sources it needs (see its SOURCES)
+QT += core testlib
+QT -= gui
+
+CONFIG += c++11
+CONFIG += warn_on
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += $$PWD/.. $$PWD
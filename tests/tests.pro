@@ -0,0 +1,7 @@
+# unit tests. qmake tests/tests.pro && make check
+TEMPLATE = subdirs
+
+SUBDIRS += tst_seqlock \
+    tst_indicators \
+    tst_providercandles \
+    tst_exchangebitfinex
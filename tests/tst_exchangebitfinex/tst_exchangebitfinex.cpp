@@ -0,0 +1,131 @@
+#include <QtTest>
+#include <QStringList>
+#include "exchangebitfinex.h"
+
+/* the websocket messages can contain multiple json documents concatenated.
+ * parseJson has to dispatch each of them exactly once and in order, no matter
+ * whether it's handled by the scanner fast path (book/trades updates) or via
+ * QJsonDocument (events, snapshots, account info). An incomplete document or
+ * garbage ends the message (reported as parse error) without dispatching it.
+ * The messages are fed via the textMessageReceived slot, no connection needed.
+ */
+class tst_ExchangeBitfinex : public QObject
+{
+    Q_OBJECT
+private slots:
+    void parseJson_data();
+    void parseJson();
+};
+
+namespace {
+
+// builds messages with consecutive sequence numbers (SEQ_ALL) starting at 1
+class Msg
+{
+public:
+    Msg() : _seq(0) {}
+    QString _msg;
+
+    Msg &add(const QString &doc, const char *sep = "") { _msg.append(doc).append(sep); return *this; }
+    Msg &raw(const QString &s) { _msg.append(s); return *this; }
+    Msg &subscribedBook() { return add("{\"event\":\"subscribed\",\"channel\":\"book\",\"chanId\":5,\"symbol\":\"tBTCUSD\",\"prec\":\"P0\",\"freq\":\"F0\",\"len\":\"25\",\"pair\":\"BTCUSD\"}"); }
+    Msg &subscribedTrades() { return add("{\"event\":\"subscribed\",\"channel\":\"trades\",\"chanId\":7,\"symbol\":\"tBTCUSD\",\"pair\":\"BTCUSD\"}"); }
+    Msg &bookSnapshot() { return add(QString("[5,[[6131.3,1,0.5],[6131.2,2,1.5],[6131.4,1,-0.3],[6131.5,3,-2]],%1]").arg(++_seq)); }
+    Msg &bookUpdate(double price, double amount, const char *sep = "") { return add(QString("[5,[%1,1,%2],%3]").arg(price).arg(amount).arg(++_seq), sep); }
+    Msg &trade(int id, double amount, const char *sep = "") { return add(QString("[7,\"te\",[%1,1518901200000,%2,6131.3],%3]").arg(id).arg(amount).arg(++_seq), sep); }
+    Msg &heartbeat(const char *sep = "") { return add(QString("[5,\"hb\",%1]").arg(++_seq), sep); }
+    // type is written as is (already json escaped)
+    Msg &walletUpdate(const QString &type, int amount, const char *sep = "") { return add(QString("[0,\"wu\",[\"%1\",\"USD\",%2,0,null],%3]").arg(type).arg(amount).arg(++_seq), sep); }
+private:
+    int _seq;
+};
+
+} // namespace
+
+void tst_ExchangeBitfinex::parseJson_data()
+{
+    QTest::addColumn<QString>("msg");
+    QTest::addColumn<QStringList>("expected"); // dispatched documents in order
+
+    QTest::newRow("single update") << Msg().subscribedBook().bookSnapshot().bookUpdate(6131.3, 0.7)._msg
+                                   << QStringList({"sub 5", "data 5", "data 5"});
+
+    QTest::newRow("account info") << QString(
+         "[0,\"on\",[4513036628,null,1089,\"tBTCUSD\",1508594741965,1508594741965,-0.0491981,-0.0491981,\"EXCHANGE LIMIT\""
+         ",null,null,null,0,\"ACTIVE\",null,null,6131.3,0,0,0,null,null,null,0,0,0]]"
+         "[0,\"wu\",[\"exchange\",\"USD\",1832.71277469,0,null]]"
+         "[0,\"wu\",[\"exchange\",\"USD\",1832.71277468,0,null]]")
+                                  << QStringList({"wu exchange USD 1832.71277469", "wu exchange USD 1832.71277468"});
+
+    {
+        // fast path and QJsonDocument ones mixed, with whitespace between and strings with brackets/escapes
+        Msg m;
+        QStringList expected({"sub 5", "sub 7", "data 5"});
+        m.subscribedBook().subscribedTrades().bookSnapshot();
+        const char *seps[] = { "", " ", "\n", "\r\n\t" };
+        for (int i = 0; i < 12; ++i) {
+            const char *sep = seps[i % 4];
+            m.bookUpdate(6131.2 - i / 10.0, 0.1 * (i + 1), sep);
+            m.walletUpdate("exchange", 100 + i, sep);
+            m.trade(1000 + i, i % 2 ? 0.01 : -0.01, sep);
+            m.heartbeat(sep);
+            expected << "data 5" << QString("wu exchange USD %1").arg(100 + i) << "data 7" << "data 5";
+        }
+        m.walletUpdate("exchange ] [ \\\"x\\\\", 42, " ");
+        expected << "wu exchange ] [ \"x\\ USD 42";
+        m.add("[9,[6131.3,1,0.5],100]"); // unknown channel: falls back to QJsonDocument and gets dropped there
+        m.bookUpdate(6132.1, -0.4);
+        expected << "data 5";
+        QTest::newRow("burst") << m._msg << expected;
+    }
+
+    QTest::newRow("truncated fast path tail") << Msg().subscribedBook().bookSnapshot().walletUpdate("exchange", 100)
+                                                 .bookUpdate(6131.3, 0.7).raw("[5,[6131.4,1,0.5],4")._msg
+                                              << QStringList({"sub 5", "data 5", "wu exchange USD 100", "data 5"});
+    QTest::newRow("truncated values") << Msg().subscribedBook().bookSnapshot().bookUpdate(6131.3, 0.7)
+                                         .raw("[5,[6131.4,1,0.")._msg
+                                      << QStringList({"sub 5", "data 5", "data 5"});
+    QTest::newRow("truncated account info") << Msg().walletUpdate("exchange", 100).walletUpdate("exchange", 101)
+                                               .raw("[0,\"wu\",[\"exchange\",\"USD\",10")._msg
+                                            << QStringList({"wu exchange USD 100", "wu exchange USD 101"});
+    QTest::newRow("truncated string") << Msg().walletUpdate("exchange", 100).raw("[0,\"wu\",[\"excha")._msg
+                                      << QStringList({"wu exchange USD 100"});
+
+    QTest::newRow("leading whitespace") << Msg().raw(" \r\n\t").walletUpdate("exchange", 100).subscribedBook()._msg
+                                        << QStringList({"wu exchange USD 100", "sub 5"});
+    QTest::newRow("leading garbage") << Msg().raw("xyz").walletUpdate("exchange", 100).walletUpdate("exchange", 101)._msg
+                                     << QStringList();
+    QTest::newRow("leading number") << Msg().raw("1").walletUpdate("exchange", 100)._msg
+                                    << QStringList();
+    QTest::newRow("leading end of array") << Msg().raw("]").subscribedBook().bookSnapshot()._msg
+                                          << QStringList();
+    QTest::newRow("garbage between") << Msg().subscribedBook().bookSnapshot().raw("xyz").bookUpdate(6131.3, 0.7)._msg
+                                     << QStringList({"sub 5", "data 5"});
+    QTest::newRow("empty") << QString() << QStringList();
+    QTest::newRow("whitespace only") << QString(" \n ") << QStringList();
+}
+
+void tst_ExchangeBitfinex::parseJson()
+{
+    QFETCH(QString, msg);
+    QFETCH(QStringList, expected);
+
+    QStringList dispatched;
+    ExchangeBitfinex exchange; // tries to connect but without an event loop nothing happens
+    connect(&exchange, &Exchange::newChannelSubscribed, [&dispatched](std::shared_ptr<Channel> channel) {
+        dispatched << QString("sub %1").arg(channel->id());
+    });
+    connect(&exchange, &Exchange::channelDataUpdated, [&dispatched](int channelId) {
+        dispatched << QString("data %1").arg(channelId);
+    });
+    connect(&exchange, &Exchange::walletUpdate, [&dispatched](QString, QString type, QString cur, double value, double) {
+        dispatched << QString("wu %1 %2 %3").arg(type, cur).arg(value, 0, 'g', 12);
+    });
+
+    QVERIFY(QMetaObject::invokeMethod(&exchange, "onTextMessageReceived", Qt::DirectConnection, Q_ARG(QString, msg)));
+    QCOMPARE(dispatched, expected);
+}
+
+QTEST_GUILESS_MAIN(tst_ExchangeBitfinex)
+
+#include "tst_exchangebitfinex.moc"
@@ -0,0 +1,19 @@
+include(../tests.pri)
+
+QT += network websockets
+
+TARGET = tst_exchangebitfinex
+
+HEADERS += $$PWD/../../exchangebitfinex.h \
+    $$PWD/../../exchangenam.h \
+    $$PWD/../../exchange.h \
+    $$PWD/../../channel.h \
+    $$PWD/../../channelaccountinfo.h \
+    $$PWD/../../jsonscanner.h
+SOURCES += tst_exchangebitfinex.cpp \
+    $$PWD/../../exchangebitfinex.cpp \
+    $$PWD/../../exchangenam.cpp \
+    $$PWD/../../exchange.cpp \
+    $$PWD/../../channel.cpp \
+    $$PWD/../../channelaccountinfo.cpp \
+    $$PWD/../../roundingdouble.cpp
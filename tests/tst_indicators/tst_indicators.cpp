@@ -0,0 +1,174 @@
+#include <cmath>
+#include <vector>
+#include <QtTest>
+#include <QFile>
+#include <QTextStream>
+#include <ta-lib/ta_func.h>
+#include "indicators.h"
+
+/* the incremental IndicatorRSI has to match TA_RSI over the same closes, both
+ * for the closed candles (value() with the next close as forming candle) and
+ * right from the first value on.
+ * Further close series (one per line, # comments) can be checked by setting
+ * CRYPTOTRADER_TEST_CLOSES to the file name.
+ * The running window sums of IndicatorBollinger and IndicatorVWAP have to match
+ * the sums over the window over a long random walk.
+ */
+class tst_Indicators : public QObject
+{
+    Q_OBJECT
+private slots:
+    void rsiMatchesTaLib_data();
+    void rsiMatchesTaLib();
+    void windowSumsMatchBruteForce_data();
+    void windowSumsMatchBruteForce();
+};
+
+typedef std::vector<double> Closes;
+Q_DECLARE_METATYPE(Closes)
+
+static Closes readCloses(const QString &fileName)
+{
+    Closes closes;
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly | QFile::Text)) return closes;
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#')) continue;
+        bool ok = false;
+        const double v = line.toDouble(&ok);
+        if (ok) closes.push_back(v);
+    }
+    return closes;
+}
+
+// deterministic random walk around start. steps of up to +-0.5%, every 8th one flat
+static Closes randomWalk(std::size_t n, double start, std::size_t nrFlatFirst)
+{
+    Closes closes;
+    quint32 x = 12345;
+    double price = start;
+    for (std::size_t i = 0; i < n; ++i) {
+        x = x * 1664525u + 1013904223u;
+        if (i >= nrFlatFirst && (i % 8)) {
+            const double r = (double)(x >> 8) / (1u << 24); // 0..1
+            price = std::round(price * (1.0 + (r - 0.5) / 100.0) * 10.0) / 10.0;
+        }
+        closes.push_back(price);
+    }
+    return closes;
+}
+
+void tst_Indicators::rsiMatchesTaLib_data()
+{
+    QTest::addColumn<Closes>("closes");
+    QTest::addColumn<int>("period");
+
+    const Closes wilder = readCloses(QFINDTESTDATA("data/rsi_closes.txt"));
+    QVERIFY(wilder.size() == 33);
+    QTest::newRow("wilder 14") << wilder << 14;
+    QTest::newRow("wilder 5") << wilder << 5;
+    QTest::newRow("walk 14") << randomWalk(2000, 10000.0, 0) << 14;
+    QTest::newRow("flat then walk 14") << randomWalk(500, 10000.0, 30) << 14;
+    const QString fileName = qgetenv("CRYPTOTRADER_TEST_CLOSES");
+    if (fileName.length())
+        QTest::newRow(qPrintable(fileName)) << readCloses(fileName) << 14;
+}
+
+void tst_Indicators::rsiMatchesTaLib()
+{
+    QFETCH(Closes, closes);
+    QFETCH(int, period);
+    QVERIFY((int)closes.size() > period);
+
+    std::vector<TA_Real> out(closes.size());
+    TA_Integer outBeg = 0;
+    TA_Integer outNbElement = 0;
+    QCOMPARE(TA_RSI(0, (int)closes.size() - 1, &closes[0], period, &outBeg, &outNbElement, &out[0]), TA_SUCCESS);
+    QCOMPARE(outBeg, period);
+    QCOMPARE(outNbElement, (int)closes.size() - period);
+
+    IndicatorRSI rsi(period);
+    IndicatorInput in = IndicatorInput();
+    for (std::size_t i = 0; i < closes.size(); ++i) {
+        in._close = closes[i];
+        double value = -1.0;
+        const bool valid = rsi.value(in, &value); // closes[i] as forming candle
+        QCOMPARE(valid, (int)i >= period);
+        if (valid) {
+            const double expected = out[i - outBeg];
+            if (std::fabs(value - expected) > 1e-8)
+                QFAIL(qPrintable(QString("RSI at %1: %2 instead of %3").arg(i).arg(value, 0, 'g', 12).arg(expected, 0, 'g', 12)));
+        }
+        rsi.add(in);
+    }
+}
+
+void tst_Indicators::windowSumsMatchBruteForce_data()
+{
+    QTest::addColumn<int>("period");
+    QTest::newRow("period 1") << 1;
+    QTest::newRow("period 2") << 2;
+    QTest::newRow("period 20") << 20;
+    QTest::newRow("period 200") << 200;
+}
+
+void tst_Indicators::windowSumsMatchBruteForce()
+{
+    QFETCH(int, period);
+    const Closes closes = randomWalk(100000, 10000.0, 0);
+    std::vector<double> volumes(closes.size());
+    quint32 x = 54321;
+    for (auto &v : volumes) {
+        x = x * 1664525u + 1013904223u;
+        v = (x >> 8) % 8 ? (double)((x >> 8) % 100000) / 1000.0 : 0.0; // some without volume
+    }
+
+    IndicatorBollinger bollinger(period, 2.0);
+    IndicatorVWAP vwap(period);
+    IndicatorInput in = IndicatorInput();
+    for (std::size_t i = 0; i < closes.size(); ++i) {
+        in._close = closes[i];
+        in._volume = volumes[i];
+        in._quoteVolume = closes[i] * volumes[i];
+        double bands[3];
+        double vwapValue = 0.0;
+        const bool validBands = bollinger.value(in, bands);
+        const bool validVwap = vwap.value(in, &vwapValue);
+        QCOMPARE(validBands, (int)i + 1 >= period);
+        if (validBands) {
+            // two pass over the window incl. the forming candle:
+            double sum = 0.0;
+            double volume = 0.0;
+            double quoteVolume = 0.0;
+            for (std::size_t j = i + 1 - period; j <= i; ++j) {
+                sum += closes[j];
+                volume += volumes[j];
+                quoteVolume += closes[j] * volumes[j];
+            }
+            const double mean = sum / period;
+            double var = 0.0;
+            for (std::size_t j = i + 1 - period; j <= i; ++j)
+                var += (closes[j] - mean) * (closes[j] - mean);
+            const double dev = 2.0 * std::sqrt(var / period);
+            // the sum of squares loses about 1e-16 * mean^2 / var of the variance:
+            if (std::fabs(bands[0] - mean) > 1e-9 * mean || std::fabs(bands[1] - (mean + dev)) > 1e-6 * mean ||
+                    std::fabs(bands[2] - (mean - dev)) > 1e-6 * mean)
+                QFAIL(qPrintable(QString("bollinger at %1: %2 %3 %4 instead of %5 %6 %7").arg(i)
+                                 .arg(bands[0], 0, 'g', 12).arg(bands[1], 0, 'g', 12).arg(bands[2], 0, 'g', 12)
+                                 .arg(mean, 0, 'g', 12).arg(mean + dev, 0, 'g', 12).arg(mean - dev, 0, 'g', 12)));
+            QCOMPARE(validVwap, volume > 0.0);
+            if (validVwap && std::fabs(vwapValue - quoteVolume / volume) > 1e-9 * mean)
+                QFAIL(qPrintable(QString("vwap at %1: %2 instead of %3").arg(i)
+                                 .arg(vwapValue, 0, 'g', 12).arg(quoteVolume / volume, 0, 'g', 12)));
+        } else
+            QVERIFY(!validVwap);
+        bollinger.add(in);
+        vwap.add(in);
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_Indicators)
+
+#include "tst_indicators.moc"
@@ -0,0 +1,9 @@
+include(../tests.pri)
+
+TARGET = tst_indicators
+
+HEADERS += $$PWD/../../indicators.h
+SOURCES += tst_indicators.cpp \
+    $$PWD/../../indicators.cpp
+
+LIBS += -lta_lib
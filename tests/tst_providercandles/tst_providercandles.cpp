@@ -0,0 +1,159 @@
+#include <cmath>
+#include <memory>
+#include <QtTest>
+#include <QDateTime>
+#include <QTemporaryDir>
+#include "providercandles.h"
+#include "testexchange.h"
+
+/* loading the candle store (bitfinex REST candles or binance klines) has to give
+ * valid indicators right away, without waiting for live trades.
+ * The data files contain 60 1min candles from 2018-02-17 21:00 to 21:59 UTC.
+ * A minute with live trades already keeps the live candle (no double counting).
+ */
+class tst_ProviderCandles : public QObject
+{
+    Q_OBJECT
+private slots:
+    void load_data();
+    void load();
+    void tooOld();
+    void saveAndLoad();
+    void overlapLive();
+};
+
+static const qint64 NewestMts = Q_INT64_C(1518904740000); // 21:59
+
+static int maxGapSecs() // so that the candles in data/ are recent enough
+{
+    return (int)((QDateTime::currentMSecsSinceEpoch() - NewestMts) / 1000 + 3600);
+}
+
+void tst_ProviderCandles::load_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<bool>("tradeDetails");
+    QTest::addColumn<double>("lastClose");
+    QTest::newRow("bitfinex") << QFINDTESTDATA("data/bitfinex_candles_1m.json") << false << 10335.7;
+    QTest::newRow("binance") << QFINDTESTDATA("data/binance_klines_1m.json") << true << 0.00104620;
+}
+
+void tst_ProviderCandles::load()
+{
+    QFETCH(QString, fileName);
+    QFETCH(bool, tradeDetails);
+    QFETCH(double, lastClose);
+
+    TestExchange exchange;
+    auto trades = std::make_shared<ChannelTrades>(&exchange, 1, "TESTBTC", "TESTBTC");
+    ProviderCandles provider(trades);
+    const int rsiId = provider.addIndicator(ProviderCandles::M1, Indicator::RSI, 14); // as the strategies do before loading
+    double rsi = -1.0;
+    QVERIFY(!provider.indicatorValue(rsiId, rsi));
+
+    QVERIFY(provider.loadCandles(fileName, maxGapSecs()));
+    const ProviderCandles::Candles &candles = provider.candles(ProviderCandles::M1);
+    QCOMPARE(candles.size(), std::size_t(60));
+    QVERIFY(candles.key(0) < candles.key(59)); // oldest first
+    QCOMPARE(candles.back()._close, lastClose);
+    QCOMPARE(candles.back()._tradeDetails, tradeDetails);
+    QCOMPARE(provider.candles(ProviderCandles::M5).size(), std::size_t(12));
+    QCOMPARE(provider.candles(ProviderCandles::H1).size(), std::size_t(1));
+
+    // valid right after loading and the same as TA_RSI over the loaded closes:
+    QVERIFY(provider.indicatorValue(rsiId, rsi));
+    QVERIFY(rsi >= 0.0 && rsi <= 100.0);
+    QVERIFY(std::fabs(rsi - provider.getRSI14TaLib(ProviderCandles::M1)) < 1e-8);
+
+    // indicators registered later get fed with the loaded candles as well:
+    const int rsi5Id = provider.addIndicator(ProviderCandles::M1, Indicator::RSI, 5);
+    double rsi5 = -1.0;
+    QVERIFY(provider.indicatorValue(rsi5Id, rsi5));
+    QCOMPARE(provider.addIndicator(ProviderCandles::M1, Indicator::RSI, 0), rsiId);
+}
+
+void tst_ProviderCandles::tooOld()
+{
+    TestExchange exchange;
+    auto trades = std::make_shared<ChannelTrades>(&exchange, 1, "TESTBTC", "TESTBTC");
+    ProviderCandles provider(trades);
+    const int rsiId = provider.addIndicator(ProviderCandles::M1, Indicator::RSI, 14);
+    QVERIFY(!provider.loadCandles(QFINDTESTDATA("data/binance_klines_1m.json"))); // default max gap 1min
+    QVERIFY(provider.candles(ProviderCandles::M1).empty());
+    double rsi;
+    QVERIFY(!provider.indicatorValue(rsiId, rsi));
+}
+
+void tst_ProviderCandles::saveAndLoad()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString storeFile = dir.path() + "/candles.json";
+    TestExchange exchange;
+    auto trades = std::make_shared<ChannelTrades>(&exchange, 1, "TESTBTC", "TESTBTC");
+    double rsi = -1.0;
+    for (const char *data : { "data/bitfinex_candles_1m.json", "data/binance_klines_1m.json" }) {
+        ProviderCandles provider(trades);
+        const int rsiId = provider.addIndicator(ProviderCandles::M1, Indicator::RSI, 14);
+        QVERIFY(provider.loadCandles(QFINDTESTDATA(data), maxGapSecs()));
+        QVERIFY(provider.indicatorValue(rsiId, rsi));
+        QVERIFY(provider.saveCandles(storeFile));
+
+        ProviderCandles reloaded(trades);
+        const int reloadedId = reloaded.addIndicator(ProviderCandles::M1, Indicator::RSI, 14);
+        QVERIFY(reloaded.loadCandles(storeFile, maxGapSecs()));
+        double reloadedRsi = -1.0;
+        QVERIFY(reloaded.indicatorValue(reloadedId, reloadedRsi));
+        QCOMPARE(reloadedRsi, rsi);
+        const ProviderCandles::Candles &a = provider.candles(ProviderCandles::M1);
+        const ProviderCandles::Candles &b = reloaded.candles(ProviderCandles::M1);
+        QCOMPARE(b.size(), a.size());
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            QVERIFY(a.key(i) == b.key(i));
+            QCOMPARE(b[i]._close, a[i]._close);
+            QCOMPARE(b[i]._volume, a[i]._volume);
+            QCOMPARE(b[i]._tradeDetails, a[i]._tradeDetails); // unknown splits stay unknown
+            if (a[i]._tradeDetails) {
+                QCOMPARE(b[i]._quoteVolume, a[i]._quoteVolume);
+                QCOMPARE(b[i]._nrTrades, a[i]._nrTrades);
+            }
+        }
+    }
+}
+
+void tst_ProviderCandles::overlapLive()
+{
+    TestExchange exchange;
+    auto trades = std::make_shared<ChannelTrades>(&exchange, 1, "TESTBTC", "TESTBTC");
+    const QString data = QFINDTESTDATA("data/binance_klines_1m.json");
+    ProviderCandles stored(trades);
+    QVERIFY(stored.loadCandles(data, maxGapSecs()));
+
+    // live trades in the newest stored minute (21:59) before the store is loaded:
+    ProviderCandles provider(trades);
+    trades->handleTrade(1, NewestMts + 1000, 5.0, 0.0010470);
+    trades->handleTrade(2, NewestMts + 2000, -3.0, 0.0010480);
+    provider.channelDataUpdated();
+    QCOMPARE(provider.candles(ProviderCandles::M1).size(), std::size_t(1));
+
+    QVERIFY(provider.loadCandles(data, maxGapSecs()));
+    const ProviderCandles::Candles &candles = provider.candles(ProviderCandles::M1);
+    const ProviderCandles::Candles &storedCandles = stored.candles(ProviderCandles::M1);
+    QCOMPARE(candles.size(), std::size_t(60));
+    QVERIFY(candles.backKey() == storedCandles.backKey());
+    // only the live trades in the overlapping minute:
+    QCOMPARE(candles.back()._nrTrades, 2);
+    QCOMPARE(candles.back()._volume, 8.0);
+    QCOMPARE(candles.back()._buyVolume, 5.0);
+    QCOMPARE(candles.back()._close, 0.0010480);
+    // the older ones as stored:
+    for (std::size_t i = 0; i + 1 < candles.size(); ++i) {
+        QVERIFY(candles.key(i) == storedCandles.key(i));
+        QCOMPARE(candles[i]._volume, storedCandles[i]._volume);
+        QCOMPARE(candles[i]._nrTrades, storedCandles[i]._nrTrades);
+    }
+}
+
+QTEST_GUILESS_MAIN(tst_ProviderCandles)
+
+#include "tst_providercandles.moc"
@@ -0,0 +1,17 @@
+include(../tests.pri)
+
+TARGET = tst_providercandles
+
+HEADERS += $$PWD/../testexchange.h \
+    $$PWD/../../providercandles.h \
+    $$PWD/../../channel.h \
+    $$PWD/../../exchange.h \
+    $$PWD/../../indicators.h
+SOURCES += tst_providercandles.cpp \
+    $$PWD/../../providercandles.cpp \
+    $$PWD/../../channel.cpp \
+    $$PWD/../../exchange.cpp \
+    $$PWD/../../roundingdouble.cpp \
+    $$PWD/../../indicators.cpp
+
+LIBS += -lta_lib
@@ -0,0 +1,170 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <QtTest>
+#include <QJsonArray>
+#include <QJsonObject>
+#include "seqlock.h"
+#include "channel.h"
+#include "testexchange.h"
+
+/* readers on other threads must never see a torn (partially written) value.
+ * The writer stores values with all words set to the same generation and the
+ * readers check that they agree (and never go back in time).
+ */
+class tst_SeqLock : public QObject
+{
+    Q_OBJECT
+private slots:
+    void storeLoad();
+    void tornReads_data();
+    void tornReads();
+    void bookSnapshotReads();
+};
+
+namespace {
+
+class Payload
+{
+public:
+    quint64 _gen[31]; // 248 bytes. about the size of ChannelBooks::BookSnapshot
+    void set(quint64 gen) { for (auto &g : _gen) g = gen; }
+    bool consistent() const
+    {
+        for (const auto &g : _gen)
+            if (g != _gen[0]) return false;
+        return true;
+    }
+};
+
+// loads until stop is set. Counts the loads and the inconsistent ones
+class Reader
+{
+public:
+    Reader() : _nrLoads(0), _nrTorn(0), _nrBackwards(0) {}
+    quint64 _nrLoads;
+    quint64 _nrTorn;
+    quint64 _nrBackwards;
+};
+
+} // namespace
+
+void tst_SeqLock::storeLoad()
+{
+    SeqLock<Payload> lock;
+    Payload p;
+    lock.load(p);
+    QVERIFY(p.consistent());
+    QCOMPARE(p._gen[0], quint64(0));
+    QCOMPARE(lock.sequence(), quint64(0));
+
+    p.set(42);
+    lock.store(p);
+    QCOMPARE(lock.sequence(), quint64(2)); // even -> stable
+    Payload q;
+    QVERIFY(lock.tryLoad(q));
+    QVERIFY(q.consistent());
+    QCOMPARE(q._gen[30], quint64(42));
+}
+
+void tst_SeqLock::tornReads_data()
+{
+    QTest::addColumn<int>("nrReaders");
+    QTest::newRow("1 reader") << 1;
+    QTest::newRow("3 readers") << 3;
+}
+
+void tst_SeqLock::tornReads()
+{
+    QFETCH(int, nrReaders);
+    const quint64 nrWrites = 500000;
+    SeqLock<Payload> lock;
+    std::atomic<bool> stop(false);
+    std::vector<Reader> readers(nrReaders);
+    std::vector<std::thread> threads;
+    for (auto &r : readers)
+        threads.emplace_back([&lock, &stop, &r]() {
+            Payload p;
+            quint64 last = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                lock.load(p);
+                ++r._nrLoads;
+                if (!p.consistent()) ++r._nrTorn;
+                if (p._gen[0] < last) ++r._nrBackwards;
+                last = p._gen[0];
+            }
+        });
+    Payload p;
+    for (quint64 gen = 1; gen <= nrWrites; ++gen) {
+        p.set(gen);
+        lock.store(p);
+    }
+    stop = true;
+    for (auto &t : threads)
+        t.join();
+
+    Payload last;
+    lock.load(last);
+    QCOMPARE(last._gen[0], nrWrites);
+    for (const auto &r : readers) {
+        QVERIFY(r._nrLoads > 0);
+        QCOMPARE(r._nrTorn, quint64(0));
+        QCOMPARE(r._nrBackwards, quint64(0));
+    }
+}
+
+// same via ChannelBooks::readSnapshot while the books get snapshots (all levels with amount gen)
+void tst_SeqLock::bookSnapshotReads()
+{
+    const int nrUpdates = 20000;
+    const int nrLevels = ChannelBooks::BookSnapshot::MaxLevels;
+    TestExchange exchange;
+    ChannelBooks book(&exchange, 1, "TESTBTC");
+    book.setTickSize(0.01);
+
+    std::atomic<bool> stop(false);
+    Reader r;
+    std::thread reader([&book, &stop, &r, nrLevels]() {
+        ChannelBooks::BookSnapshot snap;
+        quint64 lastSeq = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            book.readSnapshot(snap);
+            ++r._nrLoads;
+            if (snap._seq < lastSeq) ++r._nrBackwards;
+            lastSeq = snap._seq;
+            if (!snap._nrBids && !snap._nrAsks) continue; // none published yet
+            bool ok = snap._nrBids == nrLevels && snap._nrAsks == nrLevels;
+            for (int i = 0; ok && i < nrLevels; ++i)
+                ok = snap._bids[i]._amount == snap._bids[0]._amount && snap._asks[i]._amount == snap._bids[0]._amount &&
+                        (i == 0 || (snap._bids[i]._price < snap._bids[i - 1]._price && snap._asks[i]._price > snap._asks[i - 1]._price));
+            if (!ok) ++r._nrTorn;
+        }
+    });
+
+    for (int gen = 1; gen <= nrUpdates; ++gen) {
+        // hitbtc snapshot: {"ask":[{"price":"100.01","size":"1"},...],"bid":[...],"symbol":"TESTBTC","sequence":1}
+        QJsonArray asks;
+        QJsonArray bids;
+        const QString size = QString::number(gen);
+        for (int i = 0; i < nrLevels; ++i) {
+            asks.append(QJsonObject({{"price", QString::number(100.01 + i * 0.01 + (gen % 7) * 0.01, 'f', 2)}, {"size", size}}));
+            bids.append(QJsonObject({{"price", QString::number(100.00 - i * 0.01 + (gen % 7) * 0.01, 'f', 2)}, {"size", size}}));
+        }
+        QVERIFY(book.handleDataFromHitbtc(QJsonObject({{"ask", asks}, {"bid", bids}, {"symbol", "TESTBTC"}, {"sequence", gen}}), true));
+    }
+    stop = true;
+    reader.join();
+
+    ChannelBooks::BookSnapshot snap;
+    book.readSnapshot(snap);
+    QCOMPARE(snap._nrBids, nrLevels);
+    QCOMPARE(snap._bids[0]._amount, double(nrUpdates));
+    QCOMPARE(snap._seq, book.topOfBook()._seq);
+    QVERIFY(r._nrLoads > 0);
+    QCOMPARE(r._nrTorn, quint64(0));
+    QCOMPARE(r._nrBackwards, quint64(0));
+}
+
+QTEST_GUILESS_MAIN(tst_SeqLock)
+
+#include "tst_seqlock.moc"
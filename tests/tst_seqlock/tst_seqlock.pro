@@ -0,0 +1,11 @@
+include(../tests.pri)
+
+TARGET = tst_seqlock
+
+HEADERS += $$PWD/../testexchange.h \
+    $$PWD/../../channel.h \
+    $$PWD/../../exchange.h
+SOURCES += tst_seqlock.cpp \
+    $$PWD/../../channel.cpp \
+    $$PWD/../../exchange.cpp \
+    $$PWD/../../roundingdouble.cpp